@@ -4,9 +4,31 @@ Simple spell checker using a hash table
 
 This program implements a Map ADT using a hash table.
 The entries to the map have string keys and NO value
-Collisions in the hash table are handled by chaining into a list.
+Collisions in the hash table are handled by chaining into a linked list, or, in open
+addressing mode, by Robin Hood linear probing in a flat slot array, or, in swiss
+table mode, by probing groups of 16 slots with one SIMD tag compare per group.
+Keys are copied once into an arena and the table only holds views of them.
+A built table can be saved as a binary snapshot and mapped back in by open, which
+answers lookups straight from the mapped file until the dictionary is changed, or
+frozen into a minimal perfect hash for read-only use. An optional blocked Bloom
+filter lets check skip the table for words that are definitely misspelled.
+ConcurrentHashMap shards the dictionary over several tables with one lock each,
+so many threads can look words up at once; RcuHashMap serves lookups without any
+lock by publishing copy-on-write versions of its segments. check_file checks a
+whole document on a work-stealing thread pool. suggest lists the dictionary words
+closest to a word, found through a SymSpell deletion index, a BK-tree or by walking a
+Levenshtein automaton over a minimal DAWG of the words. After backend fst, load, save,
+open, find and check use an immutable FST dictionary instead of the hash table: a
+numbered DAWG with a payload (such as a frequency) per word, saved and mapped back in
+as one flat image; prefix lists its words that start with a prefix. After backend
+dawg, load, find, check and suggest use a minimal DAWG of the words alone, without
+the hash table.
 The program assumes that there exists a text file in the current directory:
 input.txt
+Other command files can be given on the command line; rehash.txt changes the hash
+code during incremental rehashing, and only its last check reports misspelled words.
+Run as spellChecker --stream words.txt, it instead checks the text on standard
+input and prints line:column and each misspelled word to standard output.
 
 Change log:
 2019-10-25 Boshen Wang initial version
@@ -16,12 +38,40 @@ Change log:
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <list>
-#include <sstream>
+#include <string_view>
+#include <vector>
 #include <algorithm>
 #include <cmath>
 #include <numeric>
 #include <cctype> // Added by MP to get rid of tolower() error
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <cstdint>
+#include <climits>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
@@ -45,356 +95,5365 @@ string lowercase(string s)
     return s;
 }
 
+// writes len characters starting at src to dst (which may be src) in lowercase, 32 bytes at a time.
+// Only ASCII letters change, as with tolower in the C locale.
+void lowercase(char* dst, const char* src, size_t len)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (src + i));
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+        v = _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+        _mm256_storeu_si256((__m256i*) (dst + i), v);
+    }
+#elif defined(__SSE2__)
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+                                      _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+        v = _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+        _mm_storeu_si128((__m128i*) (dst + i), v);
+    }
+#endif
+    for (; i < len; i++)
+    {
+        dst[i] = src[i] >= 'A' && src[i] <= 'Z' ? src[i] | 0x20 : src[i];
+    }
+}
+
+// converts len characters starting at s to lowercase in place
+// OUTPUT: a view of the converted characters
+string_view lowercase(char* s, size_t len)
+{
+    lowercase(s, s, len);
+    return string_view(s, len);
+}
+
+// INPUT: pointer to n <= 64 bytes of text
+// OUTPUT: bit mask with bit i set if p[i] is whitespace (as isspace in the C locale) or i >= n
+uint64_t whitespaceMask(const char* p, size_t n)
+{
+    uint64_t mask = 0;
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (p + i));
+        __m256i controls = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)),
+                                            _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v));
+        __m256i space = _mm256_or_si256(controls, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+        mask |= uint64_t(uint32_t(_mm256_movemask_epi8(space))) << i;
+    }
+#elif defined(__SSE2__)
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*) (p + i));
+        __m128i controls = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)),
+                                         _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)));
+        __m128i space = _mm_or_si128(controls, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+        mask |= uint64_t(_mm_movemask_epi8(space)) << i;
+    }
+#endif
+    for (; i < n; i++)
+    {
+        if (p[i] == ' ' || (p[i] >= '\t' && p[i] <= '\r'))
+        {
+            mask |= uint64_t(1) << i;
+        }
+    }
+    return n < 64 ? mask | ~uint64_t(0) << n : mask;
+}
+
+// Splits text into words separated by whitespace. Word boundaries are found 64 bytes at a time from a
+// whitespace bit mask, so a run of letters or of spaces costs one bit scan instead of a test per byte.
+class Tokenizer
+{
+public:
+    Tokenizer(const char* text, size_t len);
+    bool next(size_t& start, size_t& end);
+
+private:
+    const char* text;
+    size_t len;
+    size_t pos;      // where the next word is looked for
+    size_t base;     // offset of the 64 bytes described by spaces
+    uint64_t spaces; // whitespaceMask of the 64 bytes at text + base
+    size_t scan(size_t i, bool space);
+};
+
+Tokenizer::Tokenizer(const char* text, size_t len)
+{
+    this->text = text;
+    this->len = len;
+    this->pos = 0;
+    this->base = 0;
+    this->spaces = whitespaceMask(text, std::min(len, size_t(64)));
+}
+
+// OUTPUT: false when the text has no more words; otherwise the next word is text[start..end)
+bool Tokenizer::next(size_t& start, size_t& end)
+{
+    start = this->scan(this->pos, false);
+    if (start == this->len)
+    {
+        return false;
+    }
+    end = this->scan(start, true);
+    this->pos = end;
+    return true;
+}
+
+// INPUT: offset i to start at, whether to look for whitespace or for a word character
+// OUTPUT: offset of the first such byte at or after i, or len if there is none
+size_t Tokenizer::scan(size_t i, bool space)
+{
+    while (i < this->len)
+    {
+        if (i < this->base || i >= this->base + 64)
+        {
+            this->base = i;
+            this->spaces = whitespaceMask(this->text + i, std::min(this->len - i, size_t(64)));
+        }
+        uint64_t m = (space ? this->spaces : ~this->spaces) >> (i - this->base);
+        if (m != 0)
+        {
+            return std::min(i + __builtin_ctzll(m), this->len);
+        }
+        i = this->base + 64;
+    }
+    return this->len;
+}
+
+// Little-endian unaligned reads and 64x64->128 bit multiply used by the wyhash and xxHash3 style hash codes
+uint64_t read64(const char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+uint64_t read32(const char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+// OUTPUT: the low and high halves of a * b are returned in a and b
+void mul128(uint64_t& a, uint64_t& b)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t) a * b;
+    a = (uint64_t) r;
+    b = (uint64_t) (r >> 64);
+#else
+    uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t) a, lb = (uint32_t) b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    a = lo;
+    b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+// OUTPUT: the xor of the two halves of the 128-bit product a * b
+uint64_t mulFold64(uint64_t a, uint64_t b)
+{
+    mul128(a, b);
+    return a ^ b;
+}
+
+// 64-bit hash modelled on wyhash: the key is read 4, 8 or 16 bytes at a time and every block is
+// mixed in with one 64x64->128 bit multiply
+// INPUT: a string key, a seed selecting one of a family of independent hashes
+// OUTPUT: the 64-bit hash of key
+uint64_t wyhash64(string_view key, uint64_t seed)
+{
+    const uint64_t p0 = 0xa0761d6478bd642full, p1 = 0xe7037ed1a0b428dbull, p2 = 0x8ebc6af09c88c6e3ull;
+    const char* p = key.data();
+    size_t len = key.length();
+    uint64_t a, b;
+    seed ^= mulFold64(p0, p1);
+    if (len <= 16)
+    {
+        if (len >= 4)
+        {
+            a = (read32(p) << 32) | read32(p + ((len >> 3) << 2));
+            b = (read32(p + len - 4) << 32) | read32(p + len - 4 - ((len >> 3) << 2));
+        }
+        else if (len > 0)
+        {
+            a = ((uint64_t) (unsigned char) p[0] << 16) | ((uint64_t) (unsigned char) p[len >> 1] << 8) |
+                (unsigned char) p[len - 1];
+            b = 0;
+        }
+        else
+        {
+            a = b = 0;
+        }
+    }
+    else
+    {
+        size_t i = len;
+        for (; i > 16; i -= 16, p += 16)
+        {
+            seed = mulFold64(read64(p) ^ p1, read64(p + 8) ^ seed);
+        }
+        a = read64(p + i - 16);
+        b = read64(p + i - 8);
+    }
+    a ^= p1;
+    b ^= seed;
+    mul128(a, b);
+    uint64_t h = mulFold64(a ^ p0 ^ len, b ^ p2);
+    return h;
+}
+
+// CRC32C (Castagnoli) used by the crc32c hash code. The hardware versions process 8 bytes per instruction;
+// crc32cTable is the software fallback for CPUs without the CRC32 instructions.
+uint32_t crc32cTable[256];
+
+void crc32cInitTable()
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+        {
+            c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+        }
+        crc32cTable[i] = c;
+    }
+}
+
+uint32_t crc32cSoftware(const char* p, size_t len, uint32_t crc)
+{
+    static const bool initialized = (crc32cInitTable(), true); // thread-safe one-time initialization
+    (void) initialized;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = crc32cTable[(crc ^ (unsigned char) p[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <nmmintrin.h>
+
+__attribute__((target("sse4.2"))) uint32_t crc32cHardware(const char* p, size_t len, uint32_t crc)
+{
+#ifdef __x86_64__
+    uint64_t c = crc;
+    for (; len >= 8; len -= 8, p += 8)
+    {
+        c = _mm_crc32_u64(c, read64(p));
+    }
+    crc = (uint32_t) c;
+#endif
+    for (; len >= 4; len -= 4, p += 4)
+    {
+        crc = _mm_crc32_u32(crc, (uint32_t) read32(p));
+    }
+    for (; len > 0; len--, p++)
+    {
+        crc = _mm_crc32_u8(crc, (unsigned char) *p);
+    }
+    return crc;
+}
+
+bool crc32cHardwareAvailable()
+{
+    static const bool available = __builtin_cpu_supports("sse4.2");
+    return available;
+}
+#elif defined(__GNUC__) && defined(__aarch64__)
+#include <arm_acle.h>
+#ifdef __linux__
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+__attribute__((target("+crc"))) uint32_t crc32cHardware(const char* p, size_t len, uint32_t crc)
+{
+    for (; len >= 8; len -= 8, p += 8)
+    {
+        crc = __crc32cd(crc, read64(p));
+    }
+    for (; len > 0; len--, p++)
+    {
+        crc = __crc32cb(crc, (unsigned char) *p);
+    }
+    return crc;
+}
+
+bool crc32cHardwareAvailable()
+{
+#if defined(__ARM_FEATURE_CRC32)
+    return true;
+#elif defined(__linux__)
+    static const bool available = (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+    return available;
+#else
+    return false;
+#endif
+}
+#else
+uint32_t crc32cHardware(const char* p, size_t len, uint32_t crc)
+{
+    return crc32cSoftware(p, len, crc);
+}
+
+bool crc32cHardwareAvailable()
+{
+    return false;
+}
+#endif
+
+// INPUT: a buffer p of len bytes
+// OUTPUT: CRC32C of the buffer, using the CPU's CRC32 instruction when it has one
+uint32_t crc32c(const char* p, size_t len)
+{
+    if (crc32cHardwareAvailable())
+    {
+        return ~crc32cHardware(p, len, ~0u);
+    }
+    return ~crc32cSoftware(p, len, ~0u);
+}
+
+// Control bytes used by the swiss table mode. A full slot holds a 7-bit tag taken from the hash code,
+// so every control byte of a full slot is non-negative.
+const int GROUP_WIDTH = 16;
+const signed char CTRL_EMPTY = -128;
+const signed char CTRL_DELETED = -2;
+
+// INPUT: pointer to a group of GROUP_WIDTH control bytes, control byte b to look for
+// OUTPUT: bit mask with bit i set if g[i] == b
+unsigned int groupMatch(const signed char* g, signed char b)
+{
+#ifdef __SSE2__
+    __m128i ctrl = _mm_loadu_si128((const __m128i*) g);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(b)));
+#else
+    unsigned int mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; i++)
+    {
+        if (g[i] == b)
+        {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+// INPUT: pointer to a group of GROUP_WIDTH control bytes
+// OUTPUT: bit mask with bit i set if g[i] is empty or deleted
+unsigned int groupMatchFree(const signed char* g)
+{
+#ifdef __SSE2__
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) g));
+#else
+    unsigned int mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; i++)
+    {
+        if (g[i] < 0)
+        {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+// Bump allocator that stores keys back to back in large blocks. A stored key never moves, so the views
+// it hands out stay valid for the lifetime of the arena.
+class KeyArena
+{
+public:
+    static const size_t BLOCK_SIZE = 1 << 16;
+    KeyArena();
+    ~KeyArena();
+    string_view store(string_view key);
+    char* allocate(size_t len);
+    void release(size_t len);
+    size_t bytes() const;
+    size_t capacity() const;
+    void swap(KeyArena& other);
+    void absorb(KeyArena& other);
+private:
+    KeyArena(const KeyArena&);
+    KeyArena& operator=(const KeyArena&);
+    vector<char*> blocks;
+    size_t used; // bytes used in the last block
+    size_t blockSize; // size of the last block
+    size_t total; // bytes handed out
+    size_t reserved; // bytes in all blocks
+};
+
+const size_t KeyArena::BLOCK_SIZE;
+
+KeyArena::KeyArena()
+{
+    this->used = 0;
+    this->blockSize = 0;
+    this->total = 0;
+    this->reserved = 0;
+}
+
+KeyArena::~KeyArena()
+{
+    for (size_t i = 0; i < this->blocks.size(); i++)
+    {
+        delete[] this->blocks[i];
+    }
+}
+
+// INPUT: number of bytes len
+// OUTPUT: pointer to len bytes of uninitialized storage; keys longer than a block get a block of their own
+char* KeyArena::allocate(size_t len)
+{
+    if (this->blocks.empty() || this->used + len > this->blockSize)
+    {
+        this->blockSize = std::max(len, BLOCK_SIZE);
+        this->blocks.push_back(new char[this->blockSize]);
+        this->reserved += this->blockSize;
+        this->used = 0;
+    }
+    char* p = this->blocks.back() + this->used;
+    this->used += len;
+    this->total += len;
+    return p;
+}
+
+// Gives back the last len bytes handed out
+// PRECONDITION: the most recent call to allocate was for at least len bytes
+void KeyArena::release(size_t len)
+{
+    this->used -= len;
+    this->total -= len;
+}
+
+// INPUT: a string key
+// OUTPUT: a view of a copy of key held by the arena
+string_view KeyArena::store(string_view key)
+{
+    char* p = this->allocate(key.length());
+    memcpy(p, key.data(), key.length());
+    return string_view(p, key.length());
+}
+
+// OUTPUT: # of bytes handed out, including keys that have since been erased
+size_t KeyArena::bytes() const
+{
+    return this->total;
+}
+
+// OUTPUT: # of bytes allocated for blocks
+size_t KeyArena::capacity() const
+{
+    return this->reserved;
+}
+
+// Exchanges the contents of two arenas; views into either stay valid
+void KeyArena::swap(KeyArena& other)
+{
+    this->blocks.swap(other.blocks);
+    std::swap(this->used, other.used);
+    std::swap(this->blockSize, other.blockSize);
+    std::swap(this->total, other.total);
+    std::swap(this->reserved, other.reserved);
+}
+
+// Takes over the blocks of other, which is left empty; views into either arena stay valid and new keys
+// keep going into this arena's current block
+void KeyArena::absorb(KeyArena& other)
+{
+    if (this->blocks.empty())
+    {
+        this->swap(other);
+        return;
+    }
+    this->blocks.insert(this->blocks.end() - 1, other.blocks.begin(), other.blocks.end());
+    this->total += other.total;
+    this->reserved += other.reserved;
+    other.blocks.clear();
+    other.used = other.blockSize = other.total = other.reserved = 0;
+}
+
+// Blocked Bloom filter: each key sets k bits inside a single 512-bit block, so a lookup touches
+// one cache line. It never reports a key that was added as absent; other keys pass with a small
+// false-positive rate.
+class BloomFilter
+{
+public:
+    static const int BLOCK_WORDS = 8; // 64-bit words per block, one cache line
+    static const int MAX_K = 7;
+    BloomFilter();
+    void reset(size_t blocks, int k);
+    void add(uint64_t h);
+    bool mayContain(uint64_t h) const;
+    int hashCount() const;
+    size_t bytes() const;
+private:
+    vector<uint64_t> storage;
+    uint64_t* words; // storage, aligned to a cache line
+    size_t blocks;
+    int k;
+    const uint64_t* block(uint64_t h) const;
+};
+
+const int BloomFilter::BLOCK_WORDS;
+const int BloomFilter::MAX_K;
+
+BloomFilter::BloomFilter()
+{
+    this->words = NULL;
+    this->blocks = 0;
+    this->k = 1;
+}
+
+// INPUT: number of 512-bit blocks, number of bits k set per key
+// PRECONDITION: 1 <= k <= MAX_K
+// POSTCONDITION: the filter is empty (no bits set)
+void BloomFilter::reset(size_t blocks, int k)
+{
+    this->blocks = blocks;
+    this->k = k;
+    this->storage.assign(blocks * BLOCK_WORDS + BLOCK_WORDS, 0);
+    uintptr_t base = (uintptr_t) this->storage.data();
+    this->words = (uint64_t*) ((base + 63) & ~(uintptr_t) 63);
+}
+
+// INPUT: 64-bit hash h of a key
+// OUTPUT: the block of the key: the high half of h picks the block, the low half its bits
+const uint64_t* BloomFilter::block(uint64_t h) const
+{
+    return this->words + ((h >> 32) * this->blocks >> 32) * BLOCK_WORDS;
+}
+
+// INPUT: 64-bit hash h of a key
+// POSTCONDITION: the key's k bits are set; the bit positions are 9-bit slices of a remix of h
+void BloomFilter::add(uint64_t h)
+{
+    uint64_t* b = (uint64_t*) this->block(h);
+    uint64_t bits = mulFold64(h, 0x9E3779B97F4A7C15ull);
+    for (int i = 0; i < this->k; i++, bits >>= 9)
+    {
+        b[(bits >> 6) & 7] |= 1ull << (bits & 63);
+    }
+}
+
+// INPUT: 64-bit hash h of a key
+// OUTPUT: false if the key was definitely never added
+bool BloomFilter::mayContain(uint64_t h) const
+{
+    const uint64_t* b = this->block(h);
+    uint64_t bits = mulFold64(h, 0x9E3779B97F4A7C15ull);
+    bool all = true;
+    for (int i = 0; i < this->k; i++, bits >>= 9)
+    {
+        all &= (b[(bits >> 6) & 7] >> (bits & 63)) & 1;
+    }
+    return all && this->blocks > 0;
+}
+
+int BloomFilter::hashCount() const
+{
+    return this->k;
+}
+
+// OUTPUT: # of bytes of filter bits
+size_t BloomFilter::bytes() const
+{
+    return this->blocks * BLOCK_WORDS * sizeof(uint64_t);
+}
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    bool open(string fname);
+    const char* data() const;
+    size_t size() const;
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+    const char* base;
+    size_t length;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+MappedFile::MappedFile()
+{
+    this->base = NULL;
+    this->length = 0;
+#ifdef _WIN32
+    this->file = INVALID_HANDLE_VALUE;
+    this->mapping = NULL;
+#endif
+}
+
+// INPUT: name of the file to map
+// OUTPUT: true if the file could be opened; an empty file maps to a NULL pointer of size 0
+bool MappedFile::open(string fname)
+{
+#ifdef _WIN32
+    this->file = CreateFileA(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                             FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (this->file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(this->file, &fileSize);
+    this->length = fileSize.QuadPart;
+    if (this->length > 0)
+    {
+        this->mapping = CreateFileMappingA(this->file, NULL, PAGE_READONLY, 0, 0, NULL);
+        this->base = this->mapping ? (const char*) MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+        return this->base != NULL;
+    }
+    return true;
+#else
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    this->length = st.st_size;
+    if (this->length > 0)
+    {
+        void* p = mmap(NULL, this->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        this->base = p == MAP_FAILED ? NULL : (const char*) p;
+#ifdef MADV_SEQUENTIAL
+        if (this->base)
+        {
+            madvise((void*) this->base, this->length, MADV_SEQUENTIAL);
+        }
+#endif
+    }
+    close(fd);
+    return this->length == 0 || this->base != NULL;
+#endif
+}
+
+const char* MappedFile::data() const
+{
+    return this->base;
+}
+
+size_t MappedFile::size() const
+{
+    return this->length;
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (this->base)
+    {
+        UnmapViewOfFile(this->base);
+    }
+    if (this->mapping)
+    {
+        CloseHandle(this->mapping);
+    }
+    if (this->file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(this->file);
+    }
+#else
+    if (this->base)
+    {
+        munmap((void*) this->base, this->length);
+    }
+#endif
+}
+
+// Thread pool that runs numbered tasks 0..tasks-1. The tasks are dealt round-robin into one deque per
+// worker; a worker takes tasks from the front of its own deque and, once it is empty, steals from the
+// back of the other workers' deques, so uneven tasks still keep every worker busy.
+class WorkStealingPool
+{
+public:
+    WorkStealingPool(int threads);
+    ~WorkStealingPool();
+    void start(int tasks, std::function<void(int)> body);
+    void wait();
+private:
+    WorkStealingPool(const WorkStealingPool&);
+    WorkStealingPool& operator=(const WorkStealingPool&);
+    struct alignas(64) Queue
+    {
+        std::mutex lock;
+        std::deque<int> tasks;
+    };
+    int threads;
+    Queue* queues;
+    vector<std::thread> workers;
+    std::function<void(int)> body;
+    bool next(int worker, int& task);
+    void work(int worker);
+};
+
+// INPUT: number of worker threads
+// PRECONDITION: threads is positive
+WorkStealingPool::WorkStealingPool(int threads)
+{
+    this->threads = threads;
+    this->queues = new Queue[threads];
+}
+
+// INPUT: number of tasks, function run once for every task number
+// PRECONDITION: no tasks are running (wait() has returned since the last start)
+// POSTCONDITION: the workers are running the tasks; call wait() before the next start
+void WorkStealingPool::start(int tasks, std::function<void(int)> body)
+{
+    this->body = body;
+    for (int t = 0; t < tasks; t++)
+    {
+        this->queues[t % this->threads].tasks.push_back(t);
+    }
+    for (int w = 0; w < this->threads; w++)
+    {
+        this->workers.push_back(std::thread(&WorkStealingPool::work, this, w));
+    }
+}
+
+// POSTCONDITION: every task of the last start has run and the workers have exited
+void WorkStealingPool::wait()
+{
+    for (size_t w = 0; w < this->workers.size(); w++)
+    {
+        this->workers[w].join();
+    }
+    this->workers.clear();
+}
+
+// INPUT: id of the calling worker
+// OUTPUT: false once there are no tasks left anywhere; otherwise true with the task to run in task
+bool WorkStealingPool::next(int worker, int& task)
+{
+    for (int i = 0; i < this->threads; i++)
+    {
+        Queue& q = this->queues[(worker + i) % this->threads];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (!q.tasks.empty())
+        {
+            if (i == 0)
+            {
+                task = q.tasks.front();
+                q.tasks.pop_front();
+            }
+            else
+            {
+                task = q.tasks.back();
+                q.tasks.pop_back();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::work(int worker)
+{
+    int task;
+    while (this->next(worker, task))
+    {
+        this->body(task);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    this->wait();
+    delete[] this->queues;
+}
+
+// A suggested correction: a dictionary word and its edit distance from the word looked up
+struct Suggestion
+{
+    string_view word;
+    int distance;
+};
+
+// INPUT: two strings, the largest distance of interest
+// OUTPUT: Levenshtein distance between a and b, or maxDist + 1 if it is larger than maxDist
+int editDistance(string_view a, string_view b, int maxDist)
+{
+    if (a.length() > b.length())
+    {
+        std::swap(a, b);
+    }
+    if (b.length() - a.length() > (size_t) maxDist)
+    {
+        return maxDist + 1;
+    }
+    // row[j] is the distance between the first i characters of b and the first j of a
+    vector<int> row(a.length() + 1);
+    std::iota(row.begin(), row.end(), 0);
+    for (size_t i = 1; i <= b.length(); i++)
+    {
+        int diagonal = row[0], best = i;
+        row[0] = i;
+        for (size_t j = 1; j <= a.length(); j++)
+        {
+            int above = row[j];
+            row[j] = std::min(std::min(row[j] + 1, row[j - 1] + 1), diagonal + (a[j - 1] != b[i - 1]));
+            diagonal = above;
+            best = std::min(best, row[j]);
+        }
+        if (best > maxDist)
+        {
+            return maxDist + 1;
+        }
+    }
+    return std::min(row[a.length()], maxDist + 1);
+}
+
+// Bit-parallel Levenshtein distance (Myers' algorithm in Hyyro's formulation) from one pattern of up to
+// 64 characters to any number of texts. A column of the DP matrix is held as two bit vectors of vertical
+// deltas, +1 in pv and -1 in mv, so a text character costs a dozen word operations instead of one cell
+// update per pattern character. Longer patterns fall back to the DP matrix (editDistance).
+class EditPattern
+{
+public:
+    static const int MAX_LENGTH = 64;
+    EditPattern(string_view pattern);
+    int distance(string_view text, int maxDist) const;
+    void distances(const string_view* texts, size_t count, int maxDist, int* out) const;
+private:
+    string_view pattern;
+    uint64_t peq[256]; // peq[c] has bit i set if pattern[i] == c
+    uint64_t last;     // bit of the last pattern character
+};
+
+EditPattern::EditPattern(string_view pattern)
+{
+    this->pattern = pattern;
+    memset(this->peq, 0, sizeof(this->peq));
+    for (size_t i = 0; i < pattern.length() && i < MAX_LENGTH; i++)
+    {
+        this->peq[(unsigned char) pattern[i]] |= uint64_t(1) << i;
+    }
+    this->last = pattern.empty() ? 0 : uint64_t(1) << (std::min(pattern.length(), size_t(MAX_LENGTH)) - 1);
+}
+
+// INPUT: a text, the largest distance of interest
+// OUTPUT: Levenshtein distance between the pattern and text, or maxDist + 1 if it is larger than maxDist
+int EditPattern::distance(string_view text, int maxDist) const
+{
+    size_t m = this->pattern.length();
+    if (m > MAX_LENGTH || m == 0)
+    {
+        return editDistance(this->pattern, text, maxDist);
+    }
+    if ((text.length() > m ? text.length() - m : m - text.length()) > (size_t) maxDist)
+    {
+        return maxDist + 1;
+    }
+    uint64_t pv = ~uint64_t(0), mv = 0;
+    int score = m;
+    for (size_t j = 0; j < text.length(); j++)
+    {
+        uint64_t eq = this->peq[(unsigned char) text[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        score += (ph & this->last) != 0;
+        score -= (mh & this->last) != 0;
+        ph = (ph << 1) | 1; // the top row of the matrix grows by one per text character
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+        // the distance can drop by at most one per remaining text character
+        if (score - int(text.length() - j - 1) > maxDist)
+        {
+            return maxDist + 1;
+        }
+    }
+    return std::min(score, maxDist + 1);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+// Myers' algorithm on four texts at once, one per 64-bit lane; a lane stops changing when its text ends
+// INPUT: pattern bit masks peq, bit last of the last pattern character, pattern length m (1 to 64),
+// four texts
+// OUTPUT: the four edit distances in out
+__attribute__((target("avx2"))) void editDistance4(const uint64_t* peq, uint64_t last, int m,
+                                                   const string_view* texts, int* out)
+{
+    // past its end a lane rereads its last character (an empty text reads a NUL), so loads never branch
+    size_t longest = 0, end[4];
+    const char* chars[4];
+    for (int k = 0; k < 4; k++)
+    {
+        longest = std::max(longest, texts[k].length());
+        chars[k] = texts[k].empty() ? "" : texts[k].data();
+        end[k] = texts[k].empty() ? 0 : texts[k].length() - 1;
+    }
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    const __m256i lastBit = _mm256_set1_epi64x(last);
+    const __m256i lengths = _mm256_set_epi64x(texts[3].length(), texts[2].length(), texts[1].length(),
+                                              texts[0].length());
+    __m256i pv = ones, mv = _mm256_setzero_si256(), score = _mm256_set1_epi64x(m);
+    for (size_t j = 0; j < longest; j++)
+    {
+        __m256i active = _mm256_cmpgt_epi64(lengths, _mm256_set1_epi64x(j));
+        __m256i eq = _mm256_set_epi64x(peq[(unsigned char) chars[3][std::min(j, end[3])]],
+                                       peq[(unsigned char) chars[2][std::min(j, end[2])]],
+                                       peq[(unsigned char) chars[1][std::min(j, end[1])]],
+                                       peq[(unsigned char) chars[0][std::min(j, end[0])]]);
+        __m256i xv = _mm256_or_si256(eq, mv);
+        __m256i sum = _mm256_add_epi64(_mm256_and_si256(eq, pv), pv);
+        __m256i xh = _mm256_or_si256(_mm256_xor_si256(sum, pv), eq);
+        __m256i ph = _mm256_or_si256(mv, _mm256_andnot_si256(_mm256_or_si256(xh, pv), ones));
+        __m256i mh = _mm256_and_si256(pv, xh);
+        // a lane whose last bit is set compares equal to -1: subtracting adds one, adding subtracts one
+        score = _mm256_sub_epi64(score, _mm256_and_si256(active,
+                    _mm256_cmpeq_epi64(_mm256_and_si256(ph, lastBit), lastBit)));
+        score = _mm256_add_epi64(score, _mm256_and_si256(active,
+                    _mm256_cmpeq_epi64(_mm256_and_si256(mh, lastBit), lastBit)));
+        ph = _mm256_or_si256(_mm256_slli_epi64(ph, 1), _mm256_set1_epi64x(1));
+        mh = _mm256_slli_epi64(mh, 1);
+        pv = _mm256_blendv_epi8(pv, _mm256_or_si256(mh, _mm256_andnot_si256(_mm256_or_si256(xv, ph), ones)),
+                                active);
+        mv = _mm256_blendv_epi8(mv, _mm256_and_si256(ph, xv), active);
+    }
+    int64_t scores[4];
+    _mm256_storeu_si256((__m256i*) scores, score);
+    for (int k = 0; k < 4; k++)
+    {
+        out[k] = scores[k];
+    }
+}
+
+bool avx2Available()
+{
+    static const bool available = __builtin_cpu_supports("avx2");
+    return available;
+}
+#endif
+
+// distance() for many texts: with AVX2 (x86 only), four texts go through the bit-parallel kernel at once
+// INPUT: count texts, the largest distance of interest
+// OUTPUT: out[i] is the distance to texts[i], or maxDist + 1 if it is larger than maxDist
+void EditPattern::distances(const string_view* texts, size_t count, int maxDist, int* out) const
+{
+    size_t i = 0;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    int m = this->pattern.length();
+    if (m > 0 && m <= MAX_LENGTH && avx2Available())
+    {
+        for (; i + 4 <= count; i += 4)
+        {
+            editDistance4(this->peq, this->last, m, texts + i, out + i);
+            for (int k = 0; k < 4; k++)
+            {
+                out[i + k] = std::min(out[i + k], maxDist + 1);
+            }
+        }
+    }
+#endif
+    for (; i < count; i++)
+    {
+        out[i] = this->distance(texts[i], maxDist);
+    }
+}
+
+// Orders suggestions by distance, then alphabetically
+bool suggestionLess(const Suggestion& a, const Suggestion& b)
+{
+    return a.distance < b.distance || (a.distance == b.distance && a.word < b.word);
+}
+
+// SymSpell deletion index for spelling suggestions. Every word is indexed under each string made by
+// deleting up to maxDistance characters from its first prefixLength characters. A query makes the same
+// deletions of its own prefix, and only the words indexed under them can be within maxDistance of it, so
+// only they have their edit distance computed. A deletion is stored as a 64-bit hash in one sorted array
+// (a collision just adds a candidate). A longer prefix indexes more deletions per word (memory) and
+// yields fewer candidates per query (latency).
+class SymSpellIndex
+{
+public:
+    SymSpellIndex(const vector<string_view>& words, int maxDistance, int prefixLength);
+    void lookup(string_view word, int maxDist, vector<Suggestion>& out);
+    int distance() const;
+    int prefix() const;
+    size_t entries() const;
+    size_t bytes() const;
+private:
+    static const uint64_t DELETE_SEED = 0x5e11;
+    vector<string_view> words;
+    vector<uint64_t> deletes; // sorted deletion hashes
+    vector<uint32_t> owners;  // owners[i] is the index in words of the word indexed under deletes[i]
+    vector<uint32_t> seen;    // seen[w] == stamp once word w is a candidate of the current lookup
+    uint32_t stamp;
+    int maxDistance;
+    int prefixLength;
+    static void deletionHashes(string& s, size_t from, int d, vector<uint64_t>& out);
+};
+
+// INPUT: the dictionary words (views that must outlive the index), the largest distance lookups may
+// ask for, the number of leading characters of a word that are indexed
+SymSpellIndex::SymSpellIndex(const vector<string_view>& words, int maxDistance, int prefixLength)
+{
+    this->words = words;
+    this->maxDistance = maxDistance;
+    this->prefixLength = prefixLength;
+    this->seen.assign(words.size(), 0);
+    this->stamp = 0;
+    vector<std::pair<uint64_t, uint32_t> > index;
+    vector<uint64_t> hashes;
+    string prefix;
+    for (size_t w = 0; w < words.size(); w++)
+    {
+        prefix = words[w].substr(0, prefixLength);
+        hashes.clear();
+        deletionHashes(prefix, 0, maxDistance, hashes);
+        std::sort(hashes.begin(), hashes.end());
+        hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+        for (size_t i = 0; i < hashes.size(); i++)
+        {
+            index.push_back(std::make_pair(hashes[i], uint32_t(w)));
+        }
+    }
+    std::sort(index.begin(), index.end());
+    this->deletes.resize(index.size());
+    this->owners.resize(index.size());
+    for (size_t i = 0; i < index.size(); i++)
+    {
+        this->deletes[i] = index[i].first;
+        this->owners[i] = index[i].second;
+    }
+}
+
+// Appends the hash of s and of every string made by deleting up to d of its characters at positions
+// from onwards; deleting in increasing position order makes each set of positions once
+void SymSpellIndex::deletionHashes(string& s, size_t from, int d, vector<uint64_t>& out)
+{
+    out.push_back(wyhash64(s, DELETE_SEED));
+    for (size_t i = from; d > 0 && i < s.length(); i++)
+    {
+        string shorter = s;
+        shorter.erase(i, 1);
+        deletionHashes(shorter, i, d - 1, out);
+    }
+}
+
+// INPUT: a lowercase word, the largest distance to report (at most distance())
+// POSTCONDITION: every dictionary word within maxDist of word is appended to out, closest first
+void SymSpellIndex::lookup(string_view word, int maxDist, vector<Suggestion>& out)
+{
+    if (++this->stamp == 0)
+    {
+        std::fill(this->seen.begin(), this->seen.end(), 0);
+        this->stamp = 1;
+    }
+    string prefix(word.substr(0, this->prefixLength));
+    vector<uint64_t> hashes;
+    deletionHashes(prefix, 0, maxDist, hashes);
+    // gather the candidates, then verify them all in one batch
+    vector<string_view> candidates;
+    for (size_t i = 0; i < hashes.size(); i++)
+    {
+        size_t at = std::lower_bound(this->deletes.begin(), this->deletes.end(), hashes[i]) - this->deletes.begin();
+        for (; at < this->deletes.size() && this->deletes[at] == hashes[i]; at++)
+        {
+            uint32_t w = this->owners[at];
+            size_t length = this->words[w].length();
+            if (this->seen[w] == this->stamp || length + maxDist < word.length() || length > word.length() + maxDist)
+            {
+                continue;
+            }
+            this->seen[w] = this->stamp;
+            candidates.push_back(this->words[w]);
+        }
+    }
+    vector<int> distances(candidates.size());
+    EditPattern(word).distances(candidates.data(), candidates.size(), maxDist, distances.data());
+    size_t first = out.size();
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        if (distances[i] <= maxDist)
+        {
+            Suggestion suggestion = {candidates[i], distances[i]};
+            out.push_back(suggestion);
+        }
+    }
+    std::sort(out.begin() + first, out.end(), suggestionLess);
+}
+
+int SymSpellIndex::distance() const
+{
+    return this->maxDistance;
+}
+
+int SymSpellIndex::prefix() const
+{
+    return this->prefixLength;
+}
+
+// OUTPUT: number of (deletion, word) pairs indexed
+size_t SymSpellIndex::entries() const
+{
+    return this->deletes.size();
+}
+
+// OUTPUT: bytes used by the index, not counting the words themselves
+size_t SymSpellIndex::bytes() const
+{
+    return this->deletes.capacity() * sizeof(uint64_t) + this->owners.capacity() * sizeof(uint32_t) +
+           this->seen.capacity() * sizeof(uint32_t) + this->words.capacity() * sizeof(string_view);
+}
+
+// BK-tree over the dictionary words for edit-distance range queries. Each node holds one word, and a child
+// sits under its parent at their edit distance; by the triangle inequality, the words within k of a query
+// that is at distance d from a node can only be under children at distance d - k to d + k. The tree only
+// holds views of the words plus three integers per node, far less than a deletion index.
+class BKTree
+{
+public:
+    BKTree(const vector<string_view>& words);
+    void lookup(string_view word, int maxDist, vector<Suggestion>& out) const;
+    size_t nodeCount() const;
+    int depth() const;
+    size_t bytes() const;
+private:
+    struct Node
+    {
+        string_view word;
+        int distance;    // edit distance to the parent
+        int firstChild;  // index in nodes of the first child, or -1
+        int nextSibling; // index in nodes of the next child of the parent, or -1
+    };
+    vector<Node> nodes; // nodes[0] is the root
+    int height;
+};
+
+// INPUT: the dictionary words (views that must outlive the tree), which are inserted in the given order
+BKTree::BKTree(const vector<string_view>& words)
+{
+    this->height = 0;
+    this->nodes.reserve(words.size());
+    for (size_t w = 0; w < words.size(); w++)
+    {
+        Node node = {words[w], 0, -1, -1};
+        EditPattern pattern(words[w]);
+        int parent = 0, level = 1;
+        while (!this->nodes.empty())
+        {
+            int d = pattern.distance(this->nodes[parent].word, INT_MAX - 1);
+            int child = this->nodes[parent].firstChild;
+            while (child >= 0 && this->nodes[child].distance != d)
+            {
+                child = this->nodes[child].nextSibling;
+            }
+            if (child < 0)
+            {
+                node.distance = d;
+                node.nextSibling = this->nodes[parent].firstChild;
+                this->nodes[parent].firstChild = this->nodes.size();
+                break;
+            }
+            parent = child;
+            level++;
+        }
+        this->nodes.push_back(node);
+        this->height = std::max(this->height, level);
+    }
+}
+
+// INPUT: a lowercase word, the largest distance to report
+// POSTCONDITION: every dictionary word within maxDist of word is appended to out, closest first
+void BKTree::lookup(string_view word, int maxDist, vector<Suggestion>& out) const
+{
+    const int BATCH = 4;
+    size_t first = out.size();
+    EditPattern pattern(word);
+    vector<int> pending(this->nodes.empty() ? 0 : 1, 0);
+    while (!pending.empty())
+    {
+        // measure up to BATCH pending nodes at once, then queue the children in range of each
+        int batch = std::min(int(pending.size()), BATCH);
+        int ids[BATCH], d[BATCH];
+        string_view texts[BATCH];
+        for (int k = 0; k < batch; k++)
+        {
+            ids[k] = pending.back();
+            texts[k] = this->nodes[ids[k]].word;
+            pending.pop_back();
+        }
+        pattern.distances(texts, batch, INT_MAX - 1, d);
+        for (int k = 0; k < batch; k++)
+        {
+            if (d[k] <= maxDist)
+            {
+                Suggestion suggestion = {texts[k], d[k]};
+                out.push_back(suggestion);
+            }
+            for (int child = this->nodes[ids[k]].firstChild; child >= 0; child = this->nodes[child].nextSibling)
+            {
+                if (std::abs(this->nodes[child].distance - d[k]) <= maxDist)
+                {
+                    pending.push_back(child);
+                }
+            }
+        }
+    }
+    std::sort(out.begin() + first, out.end(), suggestionLess);
+}
+
+size_t BKTree::nodeCount() const
+{
+    return this->nodes.size();
+}
+
+// OUTPUT: # of nodes on the longest path from the root
+int BKTree::depth() const
+{
+    return this->height;
+}
+
+// OUTPUT: bytes used by the tree, not counting the words themselves
+size_t BKTree::bytes() const
+{
+    return this->nodes.capacity() * sizeof(Node);
+}
+
+// Minimal DAWG (deterministic acyclic word automaton) over the dictionary words. Common prefixes and
+// common suffixes are each stored once, so an inflected vocabulary takes a fraction of the memory of its
+// words. It is built from the sorted words with Daciuk's incremental algorithm: once the next word leaves
+// the path of the previous one, the states of that path are replaced, deepest first, by an equivalent
+// registered state (same accepting flag, same transitions) if there is one. Suggestions walk the
+// automaton depth first while running the query's Levenshtein automaton alongside, as one DP row per
+// depth, and leave every branch whose row has no entry within the distance, so no candidate word is
+// ever generated and checked. Besides serving as a suggestion index over the hash table's keys, a DAWG
+// loaded from a words file is a dictionary of its own (backend dawg) that keeps no copy of the words.
+class Dawg
+{
+public:
+    Dawg();
+    Dawg(const vector<string_view>& words);
+    bool load(string fname);
+    bool contains(string_view word) const;
+    void lookup(string_view word, int maxDist, vector<Suggestion>& out, KeyArena& storage) const;
+    size_t size() const;
+    size_t stateCount() const;
+    size_t transitionCount() const;
+    size_t bytes() const;
+    void printStats() const;
+private:
+    size_t wordCount;
+    // state s has the transitions first[s] to first[s + 1] - 1; accept[s] is set if a word ends in s.
+    // State 0 is the start state.
+    vector<uint32_t> first;
+    vector<char> labels;
+    vector<uint32_t> targets;
+    vector<bool> accept;
+    friend class Fst;
+    int next(int s, char c) const;
+    void walk(int s, size_t depth, string& prefix, string_view word, int maxDist, vector<int>& rows,
+              vector<Suggestion>& out, KeyArena& storage) const;
+};
+
+// POSTCONDITION: the DAWG holds no words: only the start state, which accepts nothing
+Dawg::Dawg()
+{
+    this->wordCount = 0;
+    this->first.assign(2, 0);
+    this->accept.assign(1, false);
+}
+
+// INPUT: the dictionary words, in any order and without repeats
+Dawg::Dawg(const vector<string_view>& words)
+{
+    this->wordCount = words.size();
+    struct BuildState
+    {
+        vector<std::pair<char, int> > edges; // the last edge is the one the newest word took
+        bool final;
+    };
+    vector<BuildState> states(1);
+    states[0].final = false;
+    // register of minimized states: open addressing over state ids, -1 for an empty slot
+    vector<int> registry(1024, -1);
+    size_t registered = 0;
+    auto signature = [&states](int id)
+    {
+        uint64_t h = states[id].final;
+        for (size_t i = 0; i < states[id].edges.size(); i++)
+        {
+            h = (h ^ ((uint64_t(states[id].edges[i].second) << 8) | (unsigned char) states[id].edges[i].first)) *
+                0x9E3779B97F4A7C15ull;
+        }
+        return h ^ (h >> 29);
+    };
+    // OUTPUT: a registered state equivalent to id, after registering id if there is none
+    auto canonical = [&](int id)
+    {
+        if (2 * (registered + 1) > registry.size())
+        {
+            vector<int> grown(2 * registry.size(), -1);
+            for (size_t i = 0; i < registry.size(); i++)
+            {
+                size_t j = registry[i] < 0 ? 0 : signature(registry[i]) & (grown.size() - 1);
+                while (registry[i] >= 0 && grown[j] >= 0)
+                {
+                    j = (j + 1) & (grown.size() - 1);
+                }
+                if (registry[i] >= 0)
+                {
+                    grown[j] = registry[i];
+                }
+            }
+            registry.swap(grown);
+        }
+        size_t j = signature(id) & (registry.size() - 1);
+        for (; registry[j] >= 0; j = (j + 1) & (registry.size() - 1))
+        {
+            if (states[registry[j]].final == states[id].final && states[registry[j]].edges == states[id].edges)
+            {
+                return registry[j];
+            }
+        }
+        registry[j] = id;
+        registered++;
+        return id;
+    };
+
+    vector<string_view> sorted(words);
+    std::sort(sorted.begin(), sorted.end());
+    vector<int> path(1, 0); // path[d] is the state after the first d characters of the previous word
+    string_view previous;
+    for (size_t w = 0; w <= sorted.size(); w++)
+    {
+        // the part of the previous word's path the next word does not share is now final
+        size_t common = 0;
+        while (w < sorted.size() && common < previous.length() && common < sorted[w].length() &&
+               previous[common] == sorted[w][common])
+        {
+            common++;
+        }
+        for (size_t d = path.size() - 1; d > common; d--)
+        {
+            int same = canonical(path[d]);
+            if (same != path[d])
+            {
+                states[path[d - 1]].edges.back().second = same;
+                states[path[d]].edges.clear(); // dropped
+            }
+        }
+        path.resize(common + 1);
+        if (w == sorted.size())
+        {
+            break;
+        }
+        for (size_t d = common; d < sorted[w].length(); d++)
+        {
+            BuildState state;
+            state.final = false;
+            states.push_back(state);
+            states[path[d]].edges.push_back(std::make_pair(sorted[w][d], int(states.size() - 1)));
+            path.push_back(states.size() - 1);
+        }
+        states[path.back()].final = true;
+        previous = sorted[w];
+    }
+
+    // number the states that are still reachable, breadth first, and lay them out flat
+    vector<int> number(states.size(), -1);
+    vector<int> order(1, 0);
+    number[0] = 0;
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        const BuildState& state = states[order[i]];
+        for (size_t e = 0; e < state.edges.size(); e++)
+        {
+            if (number[state.edges[e].second] < 0)
+            {
+                number[state.edges[e].second] = order.size();
+                order.push_back(state.edges[e].second);
+            }
+        }
+    }
+    this->first.reserve(order.size() + 1);
+    this->accept.reserve(order.size());
+    this->first.push_back(0);
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        const BuildState& state = states[order[i]];
+        for (size_t e = 0; e < state.edges.size(); e++)
+        {
+            this->labels.push_back(state.edges[e].first);
+            this->targets.push_back(number[state.edges[e].second]);
+        }
+        this->first.push_back(this->labels.size());
+        this->accept.push_back(state.final);
+    }
+    this->labels.shrink_to_fit();
+    this->targets.shrink_to_fit();
+}
+
+// INPUT: name of a text file containing words, one per line (no whitespace)
+// OUTPUT: false if the file cannot be opened (the DAWG is then left unchanged)
+// POSTCONDITION: the DAWG holds exactly the lowercased words of the file, replacing what it held before.
+// Blank lines are skipped, and the words are only kept for as long as the automaton is being built.
+bool Dawg::load(string fname)
+{
+    MappedFile file;
+    if (!file.open(fname))
+    {
+        return false;
+    }
+    KeyArena storage;
+    vector<string_view> words;
+    const char* end = file.data() + file.size();
+    for (const char* line = file.data(); line < end; )
+    {
+        const char* eol = (const char*) memchr(line, '\n', end - line);
+        const char* next = eol ? eol + 1 : end;
+        eol = eol ? eol : end;
+        // trim whitespace
+        while (eol > line && (eol[-1] == ' ' || eol[-1] == '\r' || eol[-1] == '\t'))
+        {
+            eol--;
+        }
+        if (eol > line)
+        {
+            char* word = storage.allocate(eol - line);
+            memcpy(word, line, eol - line);
+            words.push_back(lowercase(word, eol - line));
+        }
+        line = next;
+    }
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    Dawg built(words);
+    this->wordCount = built.wordCount;
+    this->first.swap(built.first);
+    this->labels.swap(built.labels);
+    this->targets.swap(built.targets);
+    this->accept.swap(built.accept);
+    return true;
+}
+
+// OUTPUT: the state reached from s on character c, or -1 if s has no such transition
+int Dawg::next(int s, char c) const
+{
+    for (uint32_t e = this->first[s]; e < this->first[s + 1]; e++)
+    {
+        if (this->labels[e] == c)
+        {
+            return this->targets[e];
+        }
+    }
+    return -1;
+}
+
+// OUTPUT: true if word is one of the dictionary words
+bool Dawg::contains(string_view word) const
+{
+    int s = 0;
+    for (size_t i = 0; i < word.length() && s >= 0; i++)
+    {
+        s = this->next(s, word[i]);
+    }
+    return s >= 0 && this->accept[s];
+}
+
+// INPUT: a lowercase word, the largest distance to report, an arena to hold the suggested words
+// POSTCONDITION: every dictionary word within maxDist of word is stored in storage and appended to out,
+// closest first
+void Dawg::lookup(string_view word, int maxDist, vector<Suggestion>& out, KeyArena& storage) const
+{
+    size_t first = out.size();
+    vector<int> rows(word.length() + 1);
+    std::iota(rows.begin(), rows.end(), 0); // distances from the empty prefix
+    string prefix;
+    this->walk(0, 0, prefix, word, maxDist, rows, out, storage);
+    std::sort(out.begin() + first, out.end(), suggestionLess);
+}
+
+// Visits state s, reached by prefix; row depth of rows holds the distances between prefix and every
+// prefix of word, and rows grows by one row per level
+void Dawg::walk(int s, size_t depth, string& prefix, string_view word, int maxDist, vector<int>& rows,
+                vector<Suggestion>& out, KeyArena& storage) const
+{
+    size_t m = word.length();
+    if (this->accept[s] && rows[depth * (m + 1) + m] <= maxDist)
+    {
+        Suggestion suggestion = {storage.store(prefix), rows[depth * (m + 1) + m]};
+        out.push_back(suggestion);
+    }
+    if (rows.size() < (depth + 2) * (m + 1))
+    {
+        rows.resize((depth + 2) * (m + 1));
+    }
+    for (uint32_t e = this->first[s]; e < this->first[s + 1]; e++)
+    {
+        const int* row = &rows[depth * (m + 1)];
+        int* below = &rows[(depth + 1) * (m + 1)];
+        char c = this->labels[e];
+        below[0] = row[0] + 1;
+        int best = below[0];
+        for (size_t i = 1; i <= m; i++)
+        {
+            below[i] = std::min(std::min(row[i] + 1, below[i - 1] + 1), row[i - 1] + (word[i - 1] != c));
+            best = std::min(best, below[i]);
+        }
+        if (best <= maxDist) // otherwise no word under this transition can come within maxDist
+        {
+            prefix.push_back(c);
+            this->walk(this->targets[e], depth + 1, prefix, word, maxDist, rows, out, storage);
+            prefix.pop_back();
+        }
+    }
+}
+
+// OUTPUT: number of words
+size_t Dawg::size() const
+{
+    return this->wordCount;
+}
+
+size_t Dawg::stateCount() const
+{
+    return this->accept.size();
+}
+
+size_t Dawg::transitionCount() const
+{
+    return this->labels.size();
+}
+
+// OUTPUT: bytes used by the automaton
+size_t Dawg::bytes() const
+{
+    return this->first.capacity() * sizeof(uint32_t) + this->labels.capacity() +
+           this->targets.capacity() * sizeof(uint32_t) + this->accept.capacity() / 8;
+}
+
+// OUTPUT: the following values are printed to the screen:
+// size: # of words
+// dawg states: # of states and transitions of the automaton
+// dawg bytes: memory used by the automaton
+void Dawg::printStats() const
+{
+    cout << "size:\t\t\t" << this->size() << endl;
+    cout << "dawg states:\t" << this->stateCount() << " (transitions " << this->transitionCount() << ")" << endl;
+    cout << "dawg bytes:\t\t" << this->bytes() << endl;
+}
+
 // Simple implementation of a Map ADT using a hash table.
 // Entries consist of a string key (no whitespace), without a value.
-// The table is represented using an array of linked lists in order to facilitate
-// separate chaining collision handling.
+// The table is represented using an array of chains in order to facilitate
+// separate chaining collision handling. Keys are stored in a KeyArena and the
+// table only holds views of them.
 class HashMap
 {
 public:
-    HashMap();
-    ~HashMap();
-    // standard Map ADT functions
-    int find(string key) const;
-    void put(string key);
-    void erase(string key);
-    int size() const;
-    void print() const;
-    // additional functions
-    void load(ifstream& file);
-    void resizeTable(int s);
-    void printStats() const;
-    void setHashCodeMethod(string m);
+    // default and largest edit distance of suggest()
+    static const int SUGGEST_DISTANCE = 2;
+    static const int SUGGEST_MAX_DISTANCE = 4;
+    HashMap();
+    ~HashMap();
+    // standard Map ADT functions
+    int find(string_view key) const;
+    bool check(string_view key);
+    bool contains(string_view key) const;
+    void put(string_view key);
+    void erase(string_view key);
+    int size() const;
+    void print() const;
+    // additional functions
+    void load(ifstream& file);
+    bool load(string fname);
+    void load(const char* data, size_t len);
+    bool saveSnapshot(string fname) const;
+    bool openSnapshot(string fname);
+    bool freeze();
+    void resizeTable(int s);
+    void rehash();
+    void printStats() const;
+    void analyze() const;
+    void setHashCodeMethod(string m);
+    void setTableMode(string m);
+    void setMinSize(int s);
+    void setMaxLoadFactor(double f);
+    void setMinLoadFactor(double f);
+    void setRehashMode(string m);
+    void setRehashStep(int k);
+    void setBloomBits(int b);
+    void suggest(string_view key, int maxDist, vector<Suggestion>& out);
+    void setSuggestPrefix(int p);
+    void setSuggestBackend(string m);
+private:
+    enum HCM {poly, cyclic, simple, custom, wyhash, xxh3, fnv1a, crc32};
+    enum TM {chained, open, swiss};
+    enum RM {full, incremental};
+    enum SB {symspell, bktree, dawg};
+    HCM HashCodeMethod;
+    HCM tableMethod; // hash code method the current table was built with
+    TM TableMode;
+    RM RehashMode;
+    int n;
+    int count;
+    // automatic resizing: the table doubles when count exceeds maxLoad * n and halves when count
+    // drops below minLoad * n, but never below minSize buckets
+    double maxLoad;
+    double minLoad;
+    int minSize;
+    int resizes;
+    // key storage: every key in the table is a view into keys; liveBytes excludes erased keys
+    KeyArena keys;
+    size_t liveBytes;
+    // chained mode: table[b] is the index of the first entry of bucket b's chain in entries, or -1;
+    // erased entries are kept on a free list starting at freeEntry
+    struct ChainEntry
+    {
+        string_view key;
+        int next;
+    };
+    vector<ChainEntry> entries;
+    int freeEntry;
+    int* table;
+    // incremental rehashing (chained mode): after a resize the previous table is kept in migrateTable
+    // and every put/erase moves up to rehashStep of its buckets, starting at migrateIdx, into the new
+    // table; buckets below migrateIdx are already empty. The previous table is probed with
+    // migrateMethod, the hash code method it was built with.
+    int* migrateTable;
+    int migrateN;
+    int migrateIdx;
+    HCM migrateMethod;
+    int rehashStep;
+    // open addressing: flat slot array, probes[i] is the distance of slots[i] from
+    // its home bucket, or -1 if the slot is empty
+    string_view* slots;
+    int* probes;
+    // swiss table: one control byte per slot, scanned GROUP_WIDTH at a time; deleted counts tombstones
+    signed char* ctrl;
+    int deleted;
+    int* inserts;
+    // snapshot opened by openSnapshot(): while image is set the table itself is empty and find() probes the
+    // mapped slot array instead; the first change to the dictionary thaws the snapshot back into the table.
+    // A snapshot is a header, then imageN slots (linear probing, offset IMAGE_EMPTY marks an empty slot),
+    // then the keys back to back in slot order.
+    struct ImageHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t hashMethod;
+        uint32_t slotCount;
+        uint32_t keyCount;
+        uint64_t keyBytes;
+        uint32_t checksum; // crc32c of everything after the header
+        uint32_t reserved;
+    };
+    struct ImageSlot
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+    static const uint32_t IMAGE_VERSION = 1;
+    static const uint32_t IMAGE_EMPTY = 0xFFFFFFFFu;
+    MappedFile* image;
+    const ImageSlot* imageSlots;
+    const char* imageKeys;
+    int imageN;
+    int imageCount;
+    // frozen by freeze(): the table itself is empty and the keys sit in frozenKeys, one per slot, placed
+    // by a minimal perfect hash (PTHash/CHD style). A key hashes with wyhash64(key, mphSeed) to one of
+    // pilots.size() buckets, about MPH_BUCKET_KEYS keys each on average; the bucket's pilot picks its slot
+    // among frozenSlots = frozenKeys.size() / 0.99 positions, and the few positions past the end of
+    // frozenKeys are redirected through remap.
+    // The keys themselves stay in the arena; the first change to the dictionary thaws the table.
+    static const int MPH_BUCKET_KEYS = 4;
+    static const int MPH_MAX_SEEDS = 16;
+    bool frozen;
+    vector<string_view> frozenKeys;
+    vector<uint16_t> pilots;
+    vector<uint32_t> remap;
+    uint32_t frozenSlots;
+    uint64_t mphSeed;
+    double freezeMs;
+    // Bloom filter consulted by check(): bloomBits bits per key (0 when off), sized for bloomCapacity keys
+    // and rebuilt twice as large once more keys than that have been added. Erased keys stay in the filter.
+    // bloomMisses counts checks the filter rejected, bloomFalse checks it passed that the table rejected.
+    static const uint64_t BLOOM_SEED = 0xb10f;
+    BloomFilter bloom;
+    int bloomBits;
+    size_t bloomCapacity;
+    size_t bloomAdded;
+    long bloomMisses;
+    long bloomFalse;
+    // spelling suggestions: an index over the current keys for the SuggestBackend in use (a SymSpell
+    // deletion index, a BK-tree or a DAWG), built by the first suggest() and, once there is one or a prefix
+    // length has been set, by every load. Any change to the keys drops it. The DAWG keeps no keys, so
+    // the words it suggests are copied into suggestWords.
+    SB SuggestBackend;
+    SymSpellIndex* symspellIndex;
+    BKTree* bkTree;
+    Dawg* dawgIndex;
+    KeyArena suggestWords;
+    int suggestDistance;
+    int suggestPrefix;
+    bool suggestAtLoad;
+    int hashCodePoly(string_view key) const;
+    int hashCodeSimple(string_view key) const;
+    int hashCodeCyclic(string_view key) const;
+    int hashCodeCustom(string_view key) const;
+    int hashCodeWyhash(string_view key) const;
+    int hashCodeXxh3(string_view key) const;
+    int hashCodeFnv1a(string_view key) const;
+    int hashCodeCrc32c(string_view key) const;
+    int hashCompress(int code, int s = 0) const;
+    int hashCompress(int code, int s, HCM m) const;
+    int hashCode(string_view key) const;
+    int hashCode(string_view key, HCM m) const;
+    int hash(string_view key) const;
+    signed char hashTag(int code) const;
+    int findInChain(int e, string_view key) const;
+    void chainAppend(int* t, int b, int e);
+    void chainRemove(int* t, int b, string_view key);
+    void insertKey(string_view key);
+    void insertKey(string_view key, int code);
+    void bulkLoad(const char* data, size_t len);
+    void putArenaKey(string_view key);
+    void compactArena();
+    void putSlot(string_view key, int code);
+    void eraseSlot(int idx);
+    int findGroup(string_view key) const;
+    void putGroup(string_view key, int code);
+    void eraseGroup(int idx);
+    void autoResize(int s);
+    int findPending(string_view key) const;
+    void migrateStep(int k);
+    void collectKeys(vector<string_view>& keys) const;
+    int findImage(string_view key) const;
+    uint32_t mphBucket(uint64_t h, uint32_t buckets) const;
+    uint32_t mphSlot(uint64_t h, uint16_t pilot) const;
+    int findFrozen(string_view key) const;
+    void bloomAdd(string_view key);
+    void rebuildBloom(size_t capacity);
+    void printIndexStats() const;
+    void clearTable();
+    void thaw();
+    void buildSuggestions(int maxDist);
+    void dropSuggestions();
+};
+
+HashMap::HashMap()
+{
+    this->liveBytes = 0;
+    this->freeEntry = -1;
+    this->table = NULL;
+    this->slots = NULL;
+    this->probes = NULL;
+    this->ctrl = NULL;
+    this->deleted = 0;
+    this->inserts = NULL;
+    this->image = NULL;
+    this->imageSlots = NULL;
+    this->imageKeys = NULL;
+    this->imageN = 0;
+    this->imageCount = 0;
+    this->frozen = false;
+    this->frozenSlots = 0;
+    this->mphSeed = 0;
+    this->freezeMs = 0;
+    this->bloomBits = 0;
+    this->bloomCapacity = 0;
+    this->bloomAdded = 0;
+    this->bloomMisses = 0;
+    this->bloomFalse = 0;
+    this->SuggestBackend = symspell;
+    this->symspellIndex = NULL;
+    this->bkTree = NULL;
+    this->dawgIndex = NULL;
+    this->suggestDistance = SUGGEST_DISTANCE;
+    this->suggestPrefix = 7;
+    this->suggestAtLoad = false;
+    this->HashCodeMethod = wyhash;
+    this->tableMethod = wyhash;
+    this->TableMode = chained;
+    this->RehashMode = full;
+    this->migrateTable = NULL;
+    this->migrateMethod = wyhash;
+    migrateN = 0;
+    migrateIdx = 0;
+    rehashStep = 4;
+    n = 0;
+    count = 0;
+    maxLoad = 0.75;
+    minLoad = 0.1;
+    minSize = 16;
+    resizes = 0;
+}
+
+// NAME: Melissa Paul
+// Hash code function using polynomial accumulation
+// INPUT: a string key which needs to be hashed
+// PRECONDITION: key is not null
+// OUTPUT: An integer representing the input key. The same key must always
+// produce the same output each time.
+int HashMap::hashCodePoly(string_view key) const
+{
+    int sum = 0, a = 33, j = key.length() - 1; // a is the base, j is the exponent,
+    // and key[i] - 96 is the coefficient
+    for (int i = 0; i < key.length(); i++) {
+        sum += (key[i] - 96) * pow(a, j);
+        j--;
+    }
+    return sum;
+}
+
+// NAME: Melissa Paul
+// Hash code function using a simple linear summation
+// INPUT: a string key which needs to be hashed
+// PRECONDITION: key is not null
+// OUTPUT: An integer representing the input key. The same key must always
+// produce the same output each time.
+int HashMap::hashCodeSimple(string_view key) const
+{
+    int sum = 0;
+    for (int i = 0; i < key.length(); i++) {
+        sum += key[i] - 96; // Lowercase decimal value in ASCII - 96 = value in alphabet
+    } // e.g., a = 1, b = 2,..., z = 26
+    return sum;
+}
+
+// NAME: Melissa Paul
+// Hash code function using a cyclic bit shift
+// INPUT: a string key which needs to be hashed
+// PRECONDITION: key is not null
+// OUTPUT: An integer representing the input key. The same key must always
+// produce the same output each time.
+int HashMap::hashCodeCyclic(string_view key) const // Based off pseudocode from p. 379 in textbook
+{
+    unsigned int sum = 0;
+    for (int i = 0; i < key.length(); i++) { // 5-bit cyclic shift we form bitwise or
+        sum = (sum << 5) | (sum >> 27); // of a 5 - bit left shift and a 27 - bit right shift
+        sum += (unsigned int) key[i]; // Add string character key[i]
+    }
+    return int(sum);
+}
+
+// NAME: Melissa Paul
+// Hash code function using an exponential summation.
+// INPUT: a string key which needs to be hashed
+// PRECONDITION: key is not null
+// OUTPUT: An integer representing the input key. The same key must always
+// produce the same output each time.
+int HashMap::hashCodeCustom(string_view key) const
+{
+    int sum = 0, j = key.length();
+    for (int i = 0; i < key.length(); i++) {
+        sum += pow((key[i] - 92), j); // Exponential sum
+        j--;
+    }
+    return sum;
+}
+
+
+// Hash code function using wyhash64
+// INPUT: a string key which needs to be hashed
+// OUTPUT: An integer representing the input key (the two halves of the 64-bit hash folded together).
+// The same key must always produce the same output each time.
+int HashMap::hashCodeWyhash(string_view key) const
+{
+    uint64_t h = wyhash64(key, 0);
+    return int(h ^ (h >> 32));
+}
+
+// xxHash3 style final mix of a 64-bit accumulator
+uint64_t xxh3Avalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ull;
+    return h ^ (h >> 32);
+}
+
+// Hash code function modelled on xxHash3: keys of up to 16 bytes are hashed with one or two 8-byte reads
+// keyed by a fixed secret, longer keys are consumed 16 bytes at a time with a 128-bit multiply-fold
+// INPUT: a string key which needs to be hashed
+// OUTPUT: An integer representing the input key (the two halves of the 64-bit hash folded together).
+// The same key must always produce the same output each time.
+int HashMap::hashCodeXxh3(string_view key) const
+{
+    static const uint64_t secret[8] = {
+        0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull,
+        0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull, 0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull};
+    const char* p = key.data();
+    size_t len = key.length();
+    uint64_t h;
+    if (len == 0)
+    {
+        h = xxh3Avalanche(secret[0] ^ secret[1]);
+    }
+    else if (len <= 3)
+    {
+        uint64_t combined = ((uint64_t) (unsigned char) p[0] << 16) | ((uint64_t) (unsigned char) p[len >> 1] << 24) |
+                            (unsigned char) p[len - 1] | (len << 8);
+        h = xxh3Avalanche(combined ^ (uint32_t) (secret[0] ^ (secret[0] >> 32)));
+    }
+    else if (len <= 8)
+    {
+        uint64_t keyed = ((read32(p) << 32) + read32(p + len - 4)) ^ (secret[1] ^ secret[2]);
+        keyed ^= (keyed << 49 | keyed >> 15) ^ (keyed << 24 | keyed >> 40);
+        keyed *= 0x9FB21C651E98DF25ull;
+        keyed ^= (keyed >> 35) + len;
+        keyed *= 0x9FB21C651E98DF25ull;
+        h = keyed ^ (keyed >> 28);
+    }
+    else if (len <= 16)
+    {
+        uint64_t lo = read64(p) ^ (secret[3] ^ secret[4]);
+        uint64_t hi = read64(p + len - 8) ^ (secret[5] ^ secret[6]);
+        h = xxh3Avalanche(len + __builtin_bswap64(lo) + hi + mulFold64(lo, hi));
+    }
+    else
+    {
+        uint64_t acc = len * 0x9E3779B185EBCA87ull;
+        for (size_t i = 0; i + 16 < len; i += 16)
+        {
+            acc += mulFold64(read64(p + i) ^ secret[(i / 8) % 8], read64(p + i + 8) ^ secret[(i / 8 + 1) % 8]);
+        }
+        acc += mulFold64(read64(p + len - 16) ^ secret[6], read64(p + len - 8) ^ secret[7]);
+        h = xxh3Avalanche(acc);
+    }
+    return int(h ^ (h >> 32));
+}
+
+// Hash code function using 32-bit FNV-1a: xor in each byte, then multiply by the FNV prime
+// INPUT: a string key which needs to be hashed
+// OUTPUT: An integer representing the input key. The same key must always
+// produce the same output each time.
+int HashMap::hashCodeFnv1a(string_view key) const
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < key.length(); i++)
+    {
+        h ^= (unsigned char) key[i];
+        h *= 16777619u;
+    }
+    return int(h);
+}
+
+// Hash code function using CRC32C over the whole key, 8 bytes per CRC32 instruction on CPUs with
+// SSE4.2 or the ARMv8 CRC extension (detected at runtime), and a lookup table otherwise
+// INPUT: a string key which needs to be hashed
+// OUTPUT: An integer representing the input key. The same key must always
+// produce the same output each time.
+int HashMap::hashCodeCrc32c(string_view key) const
+{
+    return int(crc32c(key.data(), key.length()));
+}
+
+// NAME: Melissa Paul
+// INPUT: an integer hash code representing a string key
+// INPUT: (optional) table size s, defaults to the size of the current table
+// OUTPUT: An integer in the range [0-n] where n is the size of the hash table.
+// The same input hash code must produce the same output each time.
+// Codes from wyhash, xxh3, fnv1a and crc32c are already well mixed and are simply reduced modulo the table size.
+int HashMap::hashCompress(int code, int s) const
+{
+    return this->hashCompress(code, s, this->HashCodeMethod);
+}
+
+// hashCompress() for a code produced by hash code method m rather than the current one
+int HashMap::hashCompress(int code, int s, HCM m) const
+{ // a ("scale") = 7, b ("shift") = 103, N = 109345121
+    if (s == 0)
+    {
+        s = this->n;
+    }
+    if (m == wyhash || m == xxh3 || m == fnv1a || m == crc32)
+    {
+        return (unsigned int) code % (unsigned int) s;
+    }
+    return (abs((7 * code) + 103) % 109345121) % s; // h(k) = | ak + b | mod N
+}
+
+// Hash code of a key using the hash code method selected by this.HashCodeMethod
+// INPUT: a string key which needs to be hashed
+// OUTPUT: An integer representing the input key, before compression
+int HashMap::hashCode(string_view key) const
+{
+    return this->hashCode(key, this->HashCodeMethod);
+}
+
+// hashCode() using hash code method m rather than the current one
+int HashMap::hashCode(string_view key, HCM m) const
+{
+    int code = 0;
+    if (m == simple)
+    {
+        code = this->hashCodeSimple(key);
+    }
+    if (m == poly)
+    {
+        code = this->hashCodePoly(key);
+    }
+    if (m == cyclic)
+    {
+        code = this->hashCodeCyclic(key);
+    }
+    if (m == custom)
+    {
+        code = this->hashCodeCustom(key);
+    }
+    if (m == wyhash)
+    {
+        code = this->hashCodeWyhash(key);
+    }
+    if (m == xxh3)
+    {
+        code = this->hashCodeXxh3(key);
+    }
+    if (m == fnv1a)
+    {
+        code = this->hashCodeFnv1a(key);
+    }
+    if (m == crc32)
+    {
+        code = this->hashCodeCrc32c(key);
+    }
+    return code;
+}
+
+// Function that consistently maps any given input string key to an integer corresponding to a bucket in the
+// hash table.
+// The hash code method used depends on the current value of this.HashCodeMethod
+// INPUT: a string key which needs to be hashed
+// OUTPUT: An integer in the range [0-n] where n is the size of the hash table.
+// The same input string key must produce the same output each time.
+int HashMap::hash(string_view key) const
+{
+    return this->hashCompress(this->hashCode(key)) % this->n;
+}
+
+// INPUT: an integer hash code representing a string key
+// OUTPUT: a 7-bit tag stored in the control byte of the key's slot in swiss table mode. The tag is
+// taken from the high bits of the mixed code so that it is independent of the bucket index.
+signed char HashMap::hashTag(int code) const
+{
+    return (signed char) ((unsigned int) code * 0x9E3779B1u >> 25);
+}
+
+// INPUT: a string key
+// OUTPUT: If the key exists in the table, return the index of the bucket containing the key
+// Otherwise, return -1
+int HashMap::find(string_view key) const
+{
+    if (this->image)
+    {
+        return this->findImage(key);
+    }
+
+    if (this->frozen)
+    {
+        return this->findFrozen(key);
+    }
+
+    if (this->n == 0)
+    {
+        return -1;
+    }
+
+    if (this->TableMode == swiss)
+    {
+        return this->findGroup(key);
+    }
+
+    // find the right bucket
+    int bucketIdx = this->hash(key);
+
+    if (this->TableMode == open)
+    {
+        // Robin Hood invariant: a key d slots away from its home bucket can only sit in a
+        // slot whose own probe distance is d, and never past a slot with a shorter distance
+        for (int d = 0; d < this->n; d++)
+        {
+            if (this->probes[bucketIdx] < d)
+            {
+                return -1;
+            }
+            if (this->probes[bucketIdx] == d && this->slots[bucketIdx] == key)
+            {
+                return bucketIdx;
+            }
+            bucketIdx = (bucketIdx + 1) % this->n;
+        }
+        return -1;
+    }
+
+    // find the key inside bucket
+    if (this->findInChain(this->table[bucketIdx], key) >= 0)
+    {
+        return bucketIdx;
+    }
+    else
+    {
+        return this->findPending(key);
+    }
+}
+
+// Lookup used by the check command: when the Bloom filter is on it is consulted first, and only keys
+// it cannot rule out are looked up in the table
+// INPUT: a string key
+// OUTPUT: true if the key is in the table
+bool HashMap::check(string_view key)
+{
+    if (this->bloomBits == 0)
+    {
+        return this->find(key) >= 0;
+    }
+    if (!this->bloom.mayContain(wyhash64(key, BLOOM_SEED)))
+    {
+        this->bloomMisses++;
+        return false;
+    }
+    bool found = this->find(key) >= 0;
+    this->bloomFalse += !found;
+    return found;
+}
+
+// Lookup that is safe to run from many threads at once while the dictionary is not changed: like check,
+// but without updating the Bloom filter counters
+// INPUT: a string key
+// OUTPUT: true if the key is in the table
+bool HashMap::contains(string_view key) const
+{
+    if (this->bloomBits > 0 && !this->bloom.mayContain(wyhash64(key, BLOOM_SEED)))
+    {
+        return false;
+    }
+    return this->find(key) >= 0;
+}
+
+// INPUT: a key that has just been inserted
+// POSTCONDITION: the key is in the Bloom filter (if it is on); the filter is rebuilt twice as large
+// when it already holds as many keys as it was sized for
+void HashMap::bloomAdd(string_view key)
+{
+    if (this->bloomBits == 0)
+    {
+        return;
+    }
+    if (this->bloomAdded >= this->bloomCapacity)
+    {
+        this->rebuildBloom(2 * this->bloomCapacity);
+        return;
+    }
+    this->bloom.add(wyhash64(key, BLOOM_SEED));
+    this->bloomAdded++;
+}
+
+// INPUT: number of keys the filter should hold at bloomBits bits per key
+// POSTCONDITION: the filter holds exactly the keys now in the dictionary (at least capacity is kept)
+void HashMap::rebuildBloom(size_t capacity)
+{
+    vector<string_view> keys;
+    this->collectKeys(keys);
+    this->bloomCapacity = std::max(std::max(capacity, keys.size()), size_t(1024));
+    size_t blockBits = BloomFilter::BLOCK_WORDS * 64;
+    // bits per key * ln 2 hashes minimize the false-positive rate
+    int k = std::min(std::max(int(this->bloomBits * 0.69 + 0.5), 1), BloomFilter::MAX_K);
+    this->bloom.reset((this->bloomCapacity * this->bloomBits + blockBits - 1) / blockBits, k);
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        this->bloom.add(wyhash64(keys[i], BLOOM_SEED));
+    }
+    this->bloomAdded = keys.size();
+}
+
+// INPUT: index of the first entry of a chain (-1 for an empty chain), a string key
+// OUTPUT: index of the entry in the chain holding key, or -1 if it is not in the chain
+int HashMap::findInChain(int e, string_view key) const
+{
+    while (e >= 0 && this->entries[e].key != key)
+    {
+        e = this->entries[e].next;
+    }
+    return e;
+}
+
+// Appends an entry at the end of a chain
+// INPUT: bucket array t, bucket index b, index e of an unlinked entry
+void HashMap::chainAppend(int* t, int b, int e)
+{
+    this->entries[e].next = -1;
+    int* link = &t[b];
+    while (*link >= 0)
+    {
+        link = &this->entries[*link].next;
+    }
+    *link = e;
+}
+
+// Unlinks the entry holding key from a chain and puts it on the free list
+// INPUT: bucket array t, bucket index b, a string key
+// PRECONDITION: key is in chain b of t
+void HashMap::chainRemove(int* t, int b, string_view key)
+{
+    int* link = &t[b];
+    while (this->entries[*link].key != key)
+    {
+        link = &this->entries[*link].next;
+    }
+    int e = *link;
+    *link = this->entries[e].next;
+    this->entries[e].next = this->freeEntry;
+    this->freeEntry = e;
+}
+
+// Looks up a key among the buckets of the previous table that have not been migrated yet
+// INPUT: a string key
+// OUTPUT: index of the bucket of migrateTable containing the key, or -1 if no migration is in progress
+// or the key is not in the unmigrated part of the previous table
+int HashMap::findPending(string_view key) const
+{
+    if (!this->migrateTable)
+    {
+        return -1;
+    }
+    int bucketIdx = this->hashCompress(this->hashCode(key, this->migrateMethod), this->migrateN, this->migrateMethod);
+    if (bucketIdx >= this->migrateIdx && this->findInChain(this->migrateTable[bucketIdx], key) >= 0)
+    {
+        return bucketIdx;
+    }
+    return -1;
+}
+
+// Moves up to k buckets of the previous table into the current one. Entries are relinked into the
+// new chains, so no key is copied. The previous bucket array is deleted once it is empty.
+// INPUT: number of buckets k to migrate
+// PRECONDITION: TableMode is chained
+void HashMap::migrateStep(int k)
+{
+    for (; k > 0 && this->migrateIdx < this->migrateN; k--)
+    {
+        int e = this->migrateTable[this->migrateIdx];
+        while (e >= 0)
+        {
+            int next = this->entries[e].next;
+            int bucketIdx = this->hash(this->entries[e].key);
+            this->chainAppend(this->table, bucketIdx, e);
+            this->inserts[bucketIdx]++;
+            e = next;
+        }
+        this->migrateIdx++;
+    }
+    if (this->migrateTable && this->migrateIdx == this->migrateN)
+    {
+        delete[] this->migrateTable;
+        this->migrateTable = NULL;
+        this->migrateN = 0;
+        this->migrateIdx = 0;
+    }
+}
+
+// NAME: Melissa Paul
+// INPUT: a string key
+// PRECONDITION: Key is not null and either exists in the table or needs to be inserted.
+// POSTCONDITION: Key is hashed and placed at the bottom of the appropriate bucket in the hash table.
+// The table is doubled if the insert pushed the load factor above maxLoad.
+void HashMap::put(string_view key)
+{
+    this->thaw();
+    this->putArenaKey(this->keys.store(key)); // copy the key into the arena, then insert
+}
+
+// put() for a key that has just been copied into the arena
+// INPUT: a view of the last key.length() bytes handed out by the arena
+// POSTCONDITION: the key is in the table; if it already was, the arena bytes are given back
+void HashMap::putArenaKey(string_view key)
+{
+    if (this->n == 0)
+    {
+        this->resizeTable(this->minSize);
+    }
+    this->migrateStep(this->rehashStep);
+    int bucketIdx = this->find(key); // Look if key already in table
+    if (bucketIdx == -1) { // If not found, insert
+        this->liveBytes += key.length();
+        this->insertKey(key);
+        this->bloomAdd(key);
+        this->dropSuggestions();
+    }
+    else { // else, the copy is not needed (no value to update)
+        this->keys.release(key.length());
+    }
+    if (this->count > this->maxLoad * this->n)
+    {
+        this->autoResize(2 * this->n);
+    }
+}
+
+// Inserts a key that is already stored in the arena, without checking whether it is in the table
+// INPUT: a view of a key in the arena
+// PRECONDITION: key is not in the table
+// POSTCONDITION: key is placed according to the current table mode, and inserts[] is updated
+void HashMap::insertKey(string_view key)
+{
+    this->insertKey(key, this->hashCode(key));
+}
+
+// insertKey for a key whose hash code is already known
+// INPUT: a view of a key in the arena, its hash code
+void HashMap::insertKey(string_view key, int code)
+{
+    if (this->TableMode == open)
+    {
+        this->putSlot(key, code);
+    }
+    else if (this->TableMode == swiss)
+    {
+        this->putGroup(key, code);
+    }
+    else
+    {
+        int e = this->freeEntry;
+        if (e >= 0)
+        {
+            this->freeEntry = this->entries[e].next;
+        }
+        else
+        {
+            e = this->entries.size();
+            this->entries.push_back(ChainEntry());
+        }
+        this->entries[e].key = key;
+        int bucketIdx = this->hashCompress(code) % this->n;
+        this->chainAppend(this->table, bucketIdx, e);
+        this->inserts[bucketIdx]++;
+        this->count++;
+    }
+}
+
+// NAME: Melissa Paul
+// INPUT: a string key
+// PRECONDITION: Key is not null and either is or isn't in the table.
+// POSTCONDITION: Key is removed from the table if it existed; otherwise, nothing happens if the key
+// wasn't in the table. The table is halved (down to minSize) if the load factor fell below minLoad.
+// The key's bytes stay in the arena until less than half of it holds live keys, when it is compacted.
+void HashMap::erase(string_view key)
+{
+    this->thaw();
+    this->migrateStep(this->rehashStep);
+    int bucketIdx = this->find(key); // Look if key is in table
+    if (bucketIdx >= 0) {
+        this->liveBytes -= key.length();
+        this->dropSuggestions();
+    }
+    if (bucketIdx >= 0 && this->TableMode == open) {
+        this->eraseSlot(bucketIdx);
+    }
+    else if (bucketIdx >= 0 && this->TableMode == swiss) {
+        this->eraseGroup(bucketIdx);
+    }
+    else if (bucketIdx >= 0 && this->findPending(key) >= 0) { // Not migrated yet
+        this->count--;
+        this->chainRemove(this->migrateTable, bucketIdx, key);
+    }
+    else if (bucketIdx >= 0) { // If found, remove and update this->inserts
+        this->count--;
+        this->chainRemove(this->table, bucketIdx, key);
+        this->inserts[bucketIdx]--;
+    } // else, do nothing
+    if (this->n > this->minSize && this->count < this->minLoad * this->n)
+    {
+        this->autoResize(std::max(this->n / 2, this->minSize));
+    }
+    if (this->keys.bytes() > 2 * this->liveBytes + KeyArena::BLOCK_SIZE)
+    {
+        this->compactArena();
+    }
+}
+
+// Copies the live keys into a fresh arena and points the table at the copies, releasing the space of
+// erased keys. Keys stay in the same slots and chains.
+void HashMap::compactArena()
+{
+    KeyArena compacted;
+    for (int i = 0; i < this->n && this->slots; i++)
+    {
+        if (this->probes ? this->probes[i] >= 0 : this->ctrl[i] >= 0)
+        {
+            this->slots[i] = compacted.store(this->slots[i]);
+        }
+    }
+    for (int i = 0; i < this->n && this->table; i++)
+    {
+        for (int e = this->table[i]; e >= 0; e = this->entries[e].next)
+        {
+            this->entries[e].key = compacted.store(this->entries[e].key);
+        }
+    }
+    for (int i = this->migrateIdx; i < this->migrateN; i++)
+    {
+        for (int e = this->migrateTable[i]; e >= 0; e = this->entries[e].next)
+        {
+            this->entries[e].key = compacted.store(this->entries[e].key);
+        }
+    }
+    this->keys.swap(compacted);
+}
+
+// Resize triggered by the table itself rather than by the user; counted in the stats
+// INPUT: new size s of the hash table
+void HashMap::autoResize(int s)
+{
+    this->resizes++;
+    this->resizeTable(s);
+}
+
+// Open addressing insert using Robin Hood linear probing: a key that is further from its home
+// bucket than the resident of a slot takes that slot, and the resident continues probing.
+// The table is doubled when it is full.
+// INPUT: a view of a key in the arena, its hash code
+// PRECONDITION: TableMode is open and key is not in the table
+// POSTCONDITION: key is stored in the slot array and inserts[] counts it against its home bucket
+void HashMap::putSlot(string_view key, int code)
+{
+    if (this->count == this->n)
+    {
+        this->autoResize(2 * this->n);
+    }
+    int idx = this->hashCompress(code) % this->n;
+    this->inserts[idx]++;
+    this->count++;
+    int d = 0;
+    while (this->probes[idx] >= 0)
+    {
+        if (this->probes[idx] < d)
+        {
+            std::swap(this->slots[idx], key);
+            std::swap(this->probes[idx], d);
+        }
+        idx = (idx + 1) % this->n;
+        d++;
+    }
+    this->slots[idx] = key;
+    this->probes[idx] = d;
+}
+
+// Open addressing erase using backward shift deletion, so no tombstones are left behind
+// INPUT: index of an occupied slot
+// POSTCONDITION: the slot is emptied and the following run of displaced keys moves back by one
+void HashMap::eraseSlot(int idx)
+{
+    this->inserts[(idx - this->probes[idx] + this->n) % this->n]--;
+    this->count--;
+    int next = (idx + 1) % this->n;
+    while (this->probes[next] > 0)
+    {
+        this->slots[idx] = this->slots[next];
+        this->probes[idx] = this->probes[next] - 1;
+        idx = next;
+        next = (next + 1) % this->n;
+    }
+    this->slots[idx] = string_view();
+    this->probes[idx] = -1;
+}
+
+// Swiss table lookup. Slots are split into groups of GROUP_WIDTH; the key's home bucket selects the
+// first group to probe, and each group is scanned for the key's tag with a single SIMD compare, so
+// most keys that are not in the table are rejected without a string comparison.
+// INPUT: a string key
+// PRECONDITION: TableMode is swiss
+// OUTPUT: index of the slot holding key, or -1 if it is not in the table
+int HashMap::findGroup(string_view key) const
+{
+    int code = this->hashCode(key);
+    signed char tag = this->hashTag(code);
+    int groups = this->n / GROUP_WIDTH;
+    int g = this->hashCompress(code) % this->n / GROUP_WIDTH;
+    for (int p = 0; p < groups; p++)
+    {
+        const signed char* c = this->ctrl + g * GROUP_WIDTH;
+        for (unsigned int m = groupMatch(c, tag); m != 0; m &= m - 1)
+        {
+            int idx = g * GROUP_WIDTH + __builtin_ctz(m);
+            if (this->slots[idx] == key)
+            {
+                return idx;
+            }
+        }
+        // a group with an empty slot never overflowed into the next one
+        if (groupMatch(c, CTRL_EMPTY))
+        {
+            return -1;
+        }
+        g = (g + 1) % groups;
+    }
+    return -1;
+}
+
+// Swiss table insert into the first empty or deleted slot along the key's group probe sequence.
+// The table is rehashed (and doubled if it is more than half full) once 7/8 of the slots are
+// full or deleted, which keeps an empty slot in every probe sequence.
+// INPUT: a view of a key in the arena, its hash code
+// PRECONDITION: TableMode is swiss and key is not in the table
+// POSTCONDITION: key is stored and inserts[] counts it against its home bucket
+void HashMap::putGroup(string_view key, int code)
+{
+    if ((this->count + this->deleted + 1) * 8 > this->n * 7)
+    {
+        this->autoResize(this->count * 2 >= this->n ? 2 * this->n : this->n);
+    }
+    int home = this->hashCompress(code) % this->n;
+    int groups = this->n / GROUP_WIDTH;
+    int g = home / GROUP_WIDTH;
+    unsigned int m = groupMatchFree(this->ctrl + g * GROUP_WIDTH);
+    while (m == 0)
+    {
+        g = (g + 1) % groups;
+        m = groupMatchFree(this->ctrl + g * GROUP_WIDTH);
+    }
+    int idx = g * GROUP_WIDTH + __builtin_ctz(m);
+    if (this->ctrl[idx] == CTRL_DELETED)
+    {
+        this->deleted--;
+    }
+    this->ctrl[idx] = this->hashTag(code);
+    this->slots[idx] = key;
+    this->inserts[home]++;
+    this->count++;
+}
+
+// Swiss table erase. The slot can be marked empty only if its group already has an empty slot,
+// because then no probe sequence ever continued past this group; otherwise it becomes a tombstone.
+// INPUT: index of a full slot
+// POSTCONDITION: the key in the slot is removed from the table
+void HashMap::eraseGroup(int idx)
+{
+    this->inserts[this->hash(this->slots[idx])]--;
+    this->count--;
+    if (groupMatch(this->ctrl + idx / GROUP_WIDTH * GROUP_WIDTH, CTRL_EMPTY))
+    {
+        this->ctrl[idx] = CTRL_EMPTY;
+    }
+    else
+    {
+        this->ctrl[idx] = CTRL_DELETED;
+        this->deleted++;
+    }
+    this->slots[idx] = string_view();
+}
+
+// Resizes the bucket array (or slot array) representing the hash table, then rehashes all existing
+// entries into the new table
+// INPUT: new size s of the hash table
+// PRECONDITION: s is positive
+// POSTCONDITION: the hash table is now size s (rounded up to a whole number of groups in swiss mode),
+// and all previous entries exist in the new table. In incremental rehash mode (chained tables only)
+// the previous table is kept and migrated a few buckets at a time by later puts and erases.
+void HashMap::resizeTable(int s)
+{
+    this->thaw();
+    // finish any migration still in progress, so there is only ever one previous table
+    this->migrateStep(this->migrateN);
+    // remember old table
+    int* oldTable = this->table;
+    int oldCount = this->count;
+    string_view* oldSlots = this->slots;
+    int* oldProbes = this->probes;
+    signed char* oldCtrl = this->ctrl;
+    int old_n = this->n;
+    vector<string_view> oldKeys;
+    if (this->TableMode == swiss)
+    {
+        s = (s + GROUP_WIDTH - 1) / GROUP_WIDTH * GROUP_WIDTH;
+    }
+    bool incrementalMove = oldTable && this->TableMode == chained && this->RehashMode == incremental;
+    if (!incrementalMove)
+    {
+        this->collectKeys(oldKeys);
+        this->entries.clear();
+        this->freeEntry = -1;
+    }
+    // reset stats
+    delete[] this->inserts;
+    this->inserts = new int[s];
+    for (int i = 0; i < s; i++)
+    {
+        this->inserts[i] = 0;
+    }
+    // initialize new table
+    this->n = s;
+    this->count = 0;
+    this->table = NULL;
+    this->slots = NULL;
+    this->probes = NULL;
+    this->ctrl = NULL;
+    this->deleted = 0;
+    if (this->TableMode == chained)
+    {
+        this->table = new int[s];
+        for (int i = 0; i < s; i++)
+        {
+            this->table[i] = -1;
+        }
+    }
+    else if (this->TableMode == open)
+    {
+        this->slots = new string_view[s];
+        this->probes = new int[s];
+        for (int i = 0; i < s; i++)
+        {
+            this->probes[i] = -1;
+        }
+    }
+    else
+    {
+        this->slots = new string_view[s];
+        this->ctrl = new signed char[s];
+        for (int i = 0; i < s; i++)
+        {
+            this->ctrl[i] = CTRL_EMPTY;
+        }
+    }
+    // leave the old table to be migrated incrementally
+    if (incrementalMove)
+    {
+        this->migrateTable = oldTable;
+        this->migrateN = old_n;
+        this->migrateIdx = 0;
+        this->migrateMethod = this->tableMethod;
+        this->count = oldCount;
+        oldTable = NULL;
+    }
+    // or re-insert everything from the old table into the new one; keys are known to be distinct,
+    // so there is no need to look them up first
+    for (size_t i = 0; i < oldKeys.size(); i++)
+    {
+        this->insertKey(oldKeys[i]);
+    }
+    this->tableMethod = this->HashCodeMethod;
+    delete[] oldTable;
+    delete[] oldSlots;
+    delete[] oldProbes;
+    delete[] oldCtrl;
+}
+
+// Rehashes every key into a table of the current size, or of minSize if the table was never sized
+void HashMap::rehash()
+{
+    this->resizeTable(this->size() > 0 ? this->size() : this->minSize);
+}
+
+// OUTPUT: size of the hash table (of the open snapshot's slot array, or of the frozen key array)
+int HashMap::size() const
+{
+    if (this->image)
+    {
+        return this->imageN;
+    }
+    if (this->frozen)
+    {
+        return this->frozenKeys.size();
+    }
+    return this->n;
+}
+
+// OUTPUT: the contents of every bucket in the hash table are printed to the screen, one line per bucket
+// (one line per slot in open addressing mode, or per key of a frozen table)
+void HashMap::print() const
+{
+    for (size_t i = 0; i < this->frozenKeys.size(); i++)
+    {
+        cout << i << ":\t" << this->frozenKeys[i] << "\t" << endl;
+    }
+    for (int i = 0; i < this->n && this->TableMode != chained; i++)
+    {
+        cout << i << ":\t";
+        if (this->probes ? this->probes[i] >= 0 : this->ctrl[i] >= 0)
+        {
+            cout << this->slots[i] << "\t";
+        }
+        cout << endl;
+    }
+    for (int i = 0; i < this->n && this->TableMode == chained; i++)
+    {
+        cout << i << ":\t";
+        for (int e = this->table[i]; e >= 0; e = this->entries[e].next)
+        {
+            cout << this->entries[e].key << "\t";
+        }
+        cout << endl;
+    }
+    // buckets of the previous table that are still waiting to be migrated
+    for (int i = this->migrateIdx; i < this->migrateN; i++)
+    {
+        cout << "old " << i << ":\t";
+        for (int e = this->migrateTable[i]; e >= 0; e = this->entries[e].next)
+        {
+            cout << this->entries[e].key << "\t";
+        }
+        cout << endl;
+    }
+}
+
+// OUTPUT: every key in the table is appended to keys, in table order, as views into the arena
+void HashMap::collectKeys(vector<string_view>& keys) const
+{
+    // storage is tested directly rather than through TableMode, which setTableMode changes before
+    // the keys are moved into the new layout
+    for (int i = 0; i < this->n && this->slots; i++)
+    {
+        if (this->probes ? this->probes[i] >= 0 : this->ctrl[i] >= 0)
+        {
+            keys.push_back(this->slots[i]);
+        }
+    }
+    for (int i = 0; i < this->n && this->table; i++)
+    {
+        for (int e = this->table[i]; e >= 0; e = this->entries[e].next)
+        {
+            keys.push_back(this->entries[e].key);
+        }
+    }
+    for (int i = this->migrateIdx; i < this->migrateN; i++)
+    {
+        for (int e = this->migrateTable[i]; e >= 0; e = this->entries[e].next)
+        {
+            keys.push_back(this->entries[e].key);
+        }
+    }
+    for (int i = 0; i < this->imageN; i++)
+    {
+        if (this->imageSlots[i].offset != IMAGE_EMPTY)
+        {
+            keys.push_back(string_view(this->imageKeys + this->imageSlots[i].offset, this->imageSlots[i].length));
+        }
+    }
+    keys.insert(keys.end(), this->frozenKeys.begin(), this->frozenKeys.end());
+}
+
+// INPUT: a text file containing input string keys, one per line (no whitespace)
+// PRECONDITION: the current hash table has been initalized (resized)
+// POSTCONDITION: all keys in the input file are inserted into the hash table
+void HashMap::load(ifstream& file)
+{
+    string line;
+    while (getline(file, line))
+    {
+        // trim whitespace
+        line.erase(line.find_last_not_of(" \n\r\t") + 1);
+        this->put(lowercase(&line[0], line.length()));
+    }
+}
+
+// Builds an empty table from a buffer of keys, one per line, using every core:
+// 1. the buffer is cut into one range per thread at line ends; each thread copies its keys into its own
+//    arena, lowercases and hashes them, and radix-partitions them by the top bits of their mixed code
+// 2. each partition is sorted by code and key on the thread pool, and every repeat of a key is dropped
+// 3. the table is sized once for the distinct keys, as setMinSize would, and they are written in file
+//    order with their known codes, with no find and no growth along the way
+// The result is the same as putting the keys one by one; the thread arenas are then merged into keys.
+// INPUT: a buffer of len bytes holding input string keys, one per line (no whitespace)
+// PRECONDITION: the table is empty
+void HashMap::bulkLoad(const char* data, size_t len)
+{
+    struct BulkKey
+    {
+        string_view key;
+        int code;
+        bool keep; // false for every occurrence of a key but the first
+    };
+    const int PARTITION_BITS = 8;
+    int threads = std::max(int(std::thread::hardware_concurrency()), 1);
+    vector<size_t> bounds(1, 0);
+    for (int t = 1; t < threads; t++)
+    {
+        size_t b = std::max(len * t / threads, bounds.back());
+        const char* eol = b < len ? (const char*) memchr(data + b, '\n', len - b) : NULL;
+        bounds.push_back(eol ? eol - data + 1 : len);
+    }
+    bounds.push_back(len);
+    KeyArena* arenas = new KeyArena[threads];
+    vector<vector<BulkKey> > items(threads);
+    vector<vector<vector<uint32_t> > > parts(threads, vector<vector<uint32_t> >(1 << PARTITION_BITS));
+    WorkStealingPool pool(threads);
+
+    pool.start(threads, [&](int t)
+    {
+        const char* end = data + bounds[t + 1];
+        for (const char* line = data + bounds[t]; line < end; )
+        {
+            const char* eol = (const char*) memchr(line, '\n', end - line);
+            const char* next = eol ? eol + 1 : end;
+            eol = eol ? eol : end;
+            // trim whitespace
+            while (eol > line && (eol[-1] == ' ' || eol[-1] == '\r' || eol[-1] == '\t'))
+            {
+                eol--;
+            }
+            char* key = arenas[t].allocate(eol - line);
+            memcpy(key, line, eol - line);
+            BulkKey item = {lowercase(key, eol - line), 0, true};
+            item.code = this->hashCode(item.key);
+            parts[t][(unsigned int) item.code * 0x9E3779B1u >> (32 - PARTITION_BITS)].push_back(items[t].size());
+            items[t].push_back(item);
+            line = next;
+        }
+    });
+    pool.wait();
+
+    pool.start(1 << PARTITION_BITS, [&](int p)
+    {
+        vector<BulkKey*> group;
+        for (int t = 0; t < threads; t++)
+        {
+            for (size_t i = 0; i < parts[t][p].size(); i++)
+            {
+                group.push_back(&items[t][parts[t][p][i]]);
+            }
+        }
+        // a stable sort keeps the occurrences of a key in file order, so the first one is kept
+        std::stable_sort(group.begin(), group.end(), [](const BulkKey* a, const BulkKey* b)
+        {
+            return a->code < b->code || (a->code == b->code && a->key < b->key);
+        });
+        for (size_t i = 1; i < group.size(); i++)
+        {
+            group[i]->keep = group[i]->code != group[i - 1]->code || group[i]->key != group[i - 1]->key;
+        }
+    });
+    pool.wait();
+
+    size_t distinct = 0;
+    for (int t = 0; t < threads; t++)
+    {
+        for (size_t i = 0; i < items[t].size(); i++)
+        {
+            distinct += items[t][i].keep;
+        }
+    }
+    int target = this->n > 0 ? this->n : this->minSize;
+    while (distinct > this->maxLoad * target)
+    {
+        target *= 2;
+        this->resizes++; // counted as the growth put() would have done
+    }
+    if (target != this->n)
+    {
+        this->resizeTable(target);
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        for (size_t i = 0; i < items[t].size(); i++)
+        {
+            if (items[t][i].keep)
+            {
+                this->insertKey(items[t][i].key, items[t][i].code);
+                this->liveBytes += items[t][i].key.length();
+            }
+        }
+        this->keys.absorb(arenas[t]);
+    }
+    delete[] arenas;
+    if (this->keys.bytes() > 2 * this->liveBytes + KeyArena::BLOCK_SIZE)
+    {
+        this->compactArena(); // the dropped repeats
+    }
+    if (this->bloomBits > 0)
+    {
+        size_t capacity = std::max(this->bloomCapacity, size_t(1024));
+        while (capacity < (size_t) this->count)
+        {
+            capacity *= 2; // as bloomAdd would have grown it
+        }
+        this->rebuildBloom(capacity);
+    }
+}
+
+// INPUT: name of a text file containing input string keys, one per line (no whitespace)
+// OUTPUT: false if the file cannot be opened
+// POSTCONDITION: all keys in the file are inserted into the hash table, reading the file through a
+// memory mapping instead of a stream
+bool HashMap::load(string fname)
+{
+    MappedFile file;
+    if (!file.open(fname))
+    {
+        return false;
+    }
+    this->load(file.data(), file.size());
+    return true;
+}
+
+// INPUT: a buffer of len bytes holding input string keys, one per line (no whitespace)
+// POSTCONDITION: all keys in the buffer are inserted into the hash table. Lines are found with memchr,
+// and each key is copied straight into the arena and lowercased there, so the buffer is never modified
+// and no temporary string is made. An empty table is built in bulk instead (see bulkLoad). The
+// suggestion index is rebuilt afterwards if one is kept.
+void HashMap::load(const char* data, size_t len)
+{
+    this->thaw();
+    this->dropSuggestions();
+    if (this->count == 0)
+    {
+        this->bulkLoad(data, len);
+    }
+    else
+    {
+        const char* end = data + len;
+        for (const char* line = data; line < end; )
+        {
+            const char* eol = (const char*) memchr(line, '\n', end - line);
+            const char* next = eol ? eol + 1 : end;
+            eol = eol ? eol : end;
+            // trim whitespace
+            while (eol > line && (eol[-1] == ' ' || eol[-1] == '\r' || eol[-1] == '\t'))
+            {
+                eol--;
+            }
+            char* key = this->keys.allocate(eol - line);
+            memcpy(key, line, eol - line);
+            this->putArenaKey(lowercase(key, eol - line));
+            line = next;
+        }
+    }
+    if (this->suggestAtLoad)
+    {
+        this->buildSuggestions(this->suggestDistance);
+    }
+}
+
+// INPUT: name of the snapshot file to write
+// OUTPUT: false if the file cannot be written, or the keys do not fit the 32-bit offsets of the format
+// POSTCONDITION: the file holds a snapshot of the dictionary that openSnapshot() can map back in. The snapshot
+// keeps the current hash code method; its slots are sized to a power of two at least twice the
+// number of keys, whatever the table mode.
+bool HashMap::saveSnapshot(string fname) const
+{
+    vector<string_view> keys;
+    this->collectKeys(keys);
+    uint64_t keyBytes = 0;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        keyBytes += keys[i].length();
+    }
+    if (keyBytes >= IMAGE_EMPTY || keys.size() > (1u << 29))
+    {
+        return false;
+    }
+    uint32_t slotCount = 16;
+    while (slotCount < 2 * keys.size())
+    {
+        slotCount *= 2;
+    }
+
+    // place the key indices by linear probing, then lay the keys out in slot order
+    vector<char> body(slotCount * sizeof(ImageSlot) + keyBytes);
+    ImageSlot* slotArr = (ImageSlot*) &body[0];
+    for (uint32_t i = 0; i < slotCount; i++)
+    {
+        slotArr[i].offset = IMAGE_EMPTY;
+        slotArr[i].length = 0;
+    }
+    for (size_t k = 0; k < keys.size(); k++)
+    {
+        int i = this->hashCompress(this->hashCode(keys[k]), slotCount);
+        while (slotArr[i].offset != IMAGE_EMPTY)
+        {
+            i = (i + 1) % slotCount;
+        }
+        slotArr[i].offset = k;
+    }
+    char* blob = &body[0] + slotCount * sizeof(ImageSlot);
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < slotCount; i++)
+    {
+        if (slotArr[i].offset != IMAGE_EMPTY)
+        {
+            string_view key = keys[slotArr[i].offset];
+            memcpy(blob + offset, key.data(), key.length());
+            slotArr[i].offset = offset;
+            slotArr[i].length = key.length();
+            offset += key.length();
+        }
+    }
+
+    ImageHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "SPELLIMG", 8);
+    header.version = IMAGE_VERSION;
+    header.hashMethod = this->HashCodeMethod;
+    header.slotCount = slotCount;
+    header.keyCount = keys.size();
+    header.keyBytes = keyBytes;
+    header.checksum = crc32c(&body[0], body.size());
+    ofstream file(fname.c_str(), ios::binary);
+    file.write((const char*) &header, sizeof(header));
+    file.write(&body[0], body.size());
+    return bool(file);
+}
+
+// INPUT: name of a snapshot file written by saveSnapshot()
+// OUTPUT: false if the file cannot be opened, is not a snapshot of this version, fails its checksum, or
+// has a slot outside the key blob, a key count that does not match its slots or no empty slot (which
+// findImage needs to stop); the dictionary is then left unchanged
+// POSTCONDITION: the dictionary holds exactly the keys of the snapshot, looked up in place in the mapped
+// file, and the hash code method is the one the snapshot was saved with. No key is copied or rehashed.
+bool HashMap::openSnapshot(string fname)
+{
+    MappedFile* file = new MappedFile();
+    bool valid = file->open(fname) && file->size() >= sizeof(ImageHeader);
+    const ImageHeader* header = (const ImageHeader*) file->data();
+    valid = valid && memcmp(header->magic, "SPELLIMG", 8) == 0 && header->version == IMAGE_VERSION &&
+            header->hashMethod <= crc32 && header->slotCount > 0 && header->slotCount <= (1u << 30) &&
+            header->keyBytes <= file->size() &&
+            file->size() == sizeof(ImageHeader) + header->slotCount * sizeof(ImageSlot) + header->keyBytes;
+    valid = valid && crc32c(file->data() + sizeof(ImageHeader), file->size() - sizeof(ImageHeader)) ==
+            header->checksum;
+    // every slot must point inside the key blob, and at least one slot must be empty
+    const ImageSlot* slots = (const ImageSlot*) (file->data() + sizeof(ImageHeader));
+    uint32_t used = 0;
+    for (uint32_t i = 0; valid && i < header->slotCount; i++)
+    {
+        if (slots[i].offset != IMAGE_EMPTY)
+        {
+            valid = uint64_t(slots[i].offset) + slots[i].length <= header->keyBytes;
+            used++;
+        }
+    }
+    valid = valid && used == header->keyCount && used < header->slotCount;
+    if (!valid)
+    {
+        delete file;
+        return false;
+    }
+
+    // drop the current dictionary
+    this->dropSuggestions();
+    delete this->image;
+    this->clearTable();
+    this->frozen = false;
+    this->frozenKeys.clear();
+    this->pilots.clear();
+    this->remap.clear();
+    KeyArena empty;
+    this->keys.swap(empty);
+    this->liveBytes = 0;
+
+    this->image = file;
+    this->HashCodeMethod = HCM(header->hashMethod);
+    this->imageN = header->slotCount;
+    this->imageCount = header->keyCount;
+    this->imageSlots = (const ImageSlot*) (file->data() + sizeof(ImageHeader));
+    this->imageKeys = file->data() + sizeof(ImageHeader) + header->slotCount * sizeof(ImageSlot);
+    if (this->bloomBits > 0)
+    {
+        this->rebuildBloom(this->imageCount);
+    }
+    return true;
+}
+
+// INPUT: a string key
+// OUTPUT: index of the snapshot slot holding key, or -1 if it is not in the snapshot
+int HashMap::findImage(string_view key) const
+{
+    int i = this->hashCompress(this->hashCode(key), this->imageN);
+    while (this->imageSlots[i].offset != IMAGE_EMPTY)
+    {
+        const ImageSlot& slot = this->imageSlots[i];
+        if (slot.length == key.length() && memcmp(this->imageKeys + slot.offset, key.data(), key.length()) == 0)
+        {
+            return i;
+        }
+        i = (i + 1) % this->imageN;
+    }
+    return -1;
+}
+
+// POSTCONDITION: the table is empty (size 0) and its arrays are freed; the arena is left alone
+void HashMap::clearTable()
+{
+    delete[] this->table;
+    delete[] this->migrateTable;
+    delete[] this->slots;
+    delete[] this->probes;
+    delete[] this->ctrl;
+    delete[] this->inserts;
+    this->table = this->migrateTable = this->inserts = this->probes = NULL;
+    this->slots = NULL;
+    this->ctrl = NULL;
+    this->migrateN = this->migrateIdx = 0;
+    this->entries.clear();
+    this->freeEntry = -1;
+    this->n = this->count = this->deleted = 0;
+}
+
+// INPUT: 64-bit hash h of a key, number of buckets of the minimal perfect hash
+// OUTPUT: the key's bucket. As in PTHash, 60% of the keys go to the first 30% of the buckets, so the
+// large buckets that are placed first (while the slots are still mostly free) hold most of the keys.
+uint32_t HashMap::mphBucket(uint64_t h, uint32_t buckets) const
+{
+    const uint64_t split = 0x99999999ull; // 60% of the 32-bit range
+    uint32_t dense = buckets * 3 / 10;
+    uint64_t hi = h >> 32;
+    if (hi < split)
+    {
+        return hi * dense / split;
+    }
+    return dense + (hi - split) * (buckets - dense) / (0x100000000ull - split);
+}
+
+// INPUT: 64-bit hash h of a key, pilot of the key's bucket
+// OUTPUT: position of the key among the frozenSlots positions of the minimal perfect hash
+uint32_t HashMap::mphSlot(uint64_t h, uint16_t pilot) const
+{
+    uint64_t x = mulFold64(h ^ (pilot * 0x9E3779B97F4A7C15ull), 0xbf58476d1ce4e5b9ull);
+    return (x >> 32) * this->frozenSlots >> 32;
+}
+
+// Builds a minimal perfect hash over the current keys and drops the table. Buckets are placed largest
+// first; each tries pilots 0, 1, 2, ... until all its keys land on free positions. Positions past the
+// last key are then given the free slots left below it through remap. If some bucket runs out of
+// pilots, the build starts over with another seed.
+// OUTPUT: false if no seed worked (the table is then left as it was)
+// POSTCONDITION: the table is frozen: find() costs one hash, one slot and one compare, and the first
+// put, erase or resize thaws it back into a normal table
+bool HashMap::freeze()
+{
+    this->thaw();
+    std::chrono::steady_clock::time_point buildStart = std::chrono::steady_clock::now();
+    vector<string_view> keys;
+    this->collectKeys(keys);
+    uint32_t m = keys.size();
+    uint32_t buckets = m / MPH_BUCKET_KEYS + 1;
+    this->frozenSlots = m + m / 99 + 1;
+    vector<uint64_t> hashes(m);
+    vector<uint32_t> order(m), bucketStart(buckets + 1), bySize;
+    vector<char> taken;
+    vector<uint32_t> pos;
+    bool placed = false;
+    for (this->mphSeed = 0; this->mphSeed < MPH_MAX_SEEDS && !placed; this->mphSeed++)
+    {
+        // counting sort of the keys by bucket, then of the buckets by size, largest first
+        std::fill(bucketStart.begin(), bucketStart.end(), 0);
+        for (uint32_t i = 0; i < m; i++)
+        {
+            hashes[i] = wyhash64(keys[i], this->mphSeed);
+            bucketStart[this->mphBucket(hashes[i], buckets) + 1]++;
+        }
+        std::partial_sum(bucketStart.begin(), bucketStart.end(), bucketStart.begin());
+        vector<uint32_t> next(bucketStart.begin(), bucketStart.end() - 1);
+        for (uint32_t i = 0; i < m; i++)
+        {
+            order[next[this->mphBucket(hashes[i], buckets)]++] = i;
+        }
+        bySize.resize(buckets);
+        std::iota(bySize.begin(), bySize.end(), 0);
+        std::stable_sort(bySize.begin(), bySize.end(), [&bucketStart](uint32_t a, uint32_t b)
+        {
+            return bucketStart[a + 1] - bucketStart[a] > bucketStart[b + 1] - bucketStart[b];
+        });
+
+        this->pilots.assign(buckets, 0);
+        taken.assign(this->frozenSlots, 0);
+        placed = true;
+        for (uint32_t k = 0; k < buckets && placed; k++)
+        {
+            uint32_t b = bySize[k], first = bucketStart[b], last = bucketStart[b + 1];
+            placed = false;
+            for (uint32_t pilot = 0; pilot <= 0xFFFF && !placed && first < last; pilot++)
+            {
+                pos.clear();
+                placed = true;
+                for (uint32_t i = first; i < last && placed; i++)
+                {
+                    uint32_t p = this->mphSlot(hashes[order[i]], pilot);
+                    placed = !taken[p] && std::find(pos.begin(), pos.end(), p) == pos.end();
+                    pos.push_back(p);
+                }
+                if (placed)
+                {
+                    this->pilots[b] = pilot;
+                    for (size_t i = 0; i < pos.size(); i++)
+                    {
+                        taken[pos[i]] = 1;
+                    }
+                }
+            }
+            placed = placed || first == last;
+        }
+    }
+    this->mphSeed--;
+    if (!placed)
+    {
+        this->pilots.clear();
+        return false;
+    }
+
+    // redirect every taken position past the last key to a free slot below it
+    this->remap.assign(this->frozenSlots - m, 0);
+    uint32_t freeSlot = 0;
+    for (uint32_t p = m; p < this->frozenSlots; p++)
+    {
+        if (taken[p])
+        {
+            while (taken[freeSlot])
+            {
+                freeSlot++;
+            }
+            this->remap[p - m] = freeSlot++;
+        }
+    }
+    this->frozenKeys.resize(m);
+    for (uint32_t i = 0; i < m; i++)
+    {
+        uint32_t p = this->mphSlot(hashes[i], this->pilots[this->mphBucket(hashes[i], buckets)]);
+        this->frozenKeys[p < m ? p : this->remap[p - m]] = keys[i];
+    }
+    this->clearTable();
+    this->frozen = true;
+    this->freezeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+    return true;
+}
+
+// INPUT: a string key
+// OUTPUT: index of the frozen slot holding key, or -1 if it is not in the table
+int HashMap::findFrozen(string_view key) const
+{
+    uint32_t m = this->frozenKeys.size();
+    if (m == 0)
+    {
+        return -1;
+    }
+    uint64_t h = wyhash64(key, this->mphSeed);
+    uint32_t p = this->mphSlot(h, this->pilots[this->mphBucket(h, this->pilots.size())]);
+    p = p < m ? p : this->remap[p - m];
+    return this->frozenKeys[p] == key ? (int) p : -1;
+}
+
+// POSTCONDITION: if a snapshot is open, its keys are inserted into the table and the file is unmapped;
+// if the table is frozen, its keys (already in the arena) are inserted back into the table
+void HashMap::thaw()
+{
+    if (!this->image && !this->frozen)
+    {
+        return;
+    }
+    MappedFile* file = this->image;
+    vector<string_view> keys;
+    this->collectKeys(keys);
+    this->image = NULL;
+    this->imageSlots = NULL;
+    this->imageKeys = NULL;
+    this->imageN = this->imageCount = 0;
+    this->frozen = false;
+    this->frozenKeys.clear();
+    this->pilots.clear();
+    this->remap.clear();
+    // size the table for all the keys up front, as setMinSize would, so it does not grow while refilled
+    int target = this->minSize;
+    while (keys.size() > this->maxLoad * target)
+    {
+        target *= 2;
+    }
+    this->resizeTable(target);
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (file)
+        {
+            this->put(keys[i]);
+        }
+        else
+        {
+            this->insertKey(keys[i]);
+        }
+    }
+    delete file;
+}
+
+// OUTPUT: the following values are printed to the screen:
+// size: size of the hash table
+// inserts: # of insertions into the hash table
+// load factor: load factor of the table (inserts/size)
+// collisions: # of collisions encountered during insertions
+// max. bucket: # of keys in the largest bucket
+// resizes: # of times the table resized itself
+// pending: # of keys still waiting in the previous table (only during incremental rehashing)
+// arena bytes: # of bytes of key storage handed out by the arena (erased keys included) / allocated
+// key bytes: # of bytes of keys currently in the table
+// In open addressing mode inserts are counted against each key's home bucket, and additionally:
+// avg. probe: average distance of a key from its home bucket
+// max. probe: largest distance of a key from its home bucket
+// In swiss table mode the probe distances are measured in groups rather than slots.
+// While a snapshot is open only its size, inserts, load factor and file size (snapshot bytes) are printed.
+// A frozen table prints its size, inserts and load factor (always 1), and:
+// mph bits/key: size of the minimal perfect hash (pilots and remap), in bits per key
+// freeze ms: time freeze took to build it
+// followed by the arena and key bytes
+// When the Bloom filter is on, in every case:
+// bloom bytes: memory used by the filter bits
+// bloom fpr: share of the misspelled words checked so far that the filter let through to the table,
+// and the rate expected of an ideal Bloom filter with as many bits per key
+// When there is a suggestion index:
+// suggest index: # of deletions indexed, prefix length and largest distance it was built for
+// suggest bytes: memory used by the index
+// or, for the BK-tree backend:
+// bktree nodes: # of nodes in the tree (one per key) and its depth
+// bktree bytes: memory used by the tree
+// or, for the DAWG backend:
+// dawg states: # of states and transitions of the automaton
+// dawg bytes: memory used by the automaton
+void HashMap::printStats() const
+{
+    if (this->frozen)
+    {
+        size_t m = this->frozenKeys.size();
+        double bits = 8.0 * (this->pilots.size() * sizeof(uint16_t) + this->remap.size() * sizeof(uint32_t));
+        cout << "size:\t\t\t" << m << endl;
+        cout << "inserts:\t\t" << m << endl;
+        cout << "load factor:\t" << (m ? 1 : 0) << endl;
+        cout << "mph bits/key:\t" << (m ? bits / m : 0.0) << endl;
+        cout << "freeze ms:\t\t" << this->freezeMs << endl;
+        cout << "arena bytes:\t" << this->keys.bytes() << " / " << this->keys.capacity() << endl;
+        cout << "key bytes:\t\t" << this->liveBytes << endl;
+        this->printIndexStats();
+        return;
+    }
+    if (this->image)
+    {
+        cout << "size:\t\t\t" << this->imageN << endl;
+        cout << "inserts:\t\t" << this->imageCount << endl;
+        cout << "load factor:\t" << double(this->imageCount) / double(this->imageN) << endl;
+        cout << "snapshot bytes:\t" << this->image->size() << endl;
+        this->printIndexStats();
+        return;
+    }
+    int sumIns = std::accumulate(this->inserts, this->inserts + this->n, 0);
+    int* collisions = new int[this->n];
+    for (int i = 0; i < this->n; i++)
+    {
+        collisions[i] = std::max(this->inserts[i] - 1, 0);
+    }
+    int sumColl = std::accumulate(collisions, collisions + this->n, 0);
+    cout << "size:\t\t\t" << this->n << endl;
+    cout << "inserts:\t\t" << sumIns << endl;
+    cout << "load factor:\t" << double(sumIns) / double(this->n) << endl;
+    cout << "collisions:\t\t" << sumColl << endl;
+    cout << "max. bucket:\t" << *std::max_element(this->inserts, this->inserts + this->n) << endl;
+    cout << "resizes:\t\t" << this->resizes << endl;
+    cout << "arena bytes:\t" << this->keys.bytes() << " / " << this->keys.capacity() << endl;
+    cout << "key bytes:\t\t" << this->liveBytes << endl;
+    if (this->migrateTable)
+    {
+        int pending = 0;
+        for (int i = this->migrateIdx; i < this->migrateN; i++)
+        {
+            for (int e = this->migrateTable[i]; e >= 0; e = this->entries[e].next)
+            {
+                pending++;
+            }
+        }
+        cout << "pending:\t\t" << pending << endl;
+    }
+    delete[] collisions;
+    long sumProbe = 0;
+    int maxProbe = 0;
+    if (this->TableMode == open)
+    {
+        for (int i = 0; i < this->n; i++)
+        {
+            if (this->probes[i] > 0)
+            {
+                sumProbe += this->probes[i];
+                maxProbe = std::max(maxProbe, this->probes[i]);
+            }
+        }
+    }
+    if (this->TableMode == swiss)
+    {
+        int groups = this->n / GROUP_WIDTH;
+        for (int i = 0; i < this->n; i++)
+        {
+            if (this->ctrl[i] >= 0)
+            {
+                int d = (i / GROUP_WIDTH - this->hash(this->slots[i]) / GROUP_WIDTH + groups) % groups;
+                sumProbe += d;
+                maxProbe = std::max(maxProbe, d);
+            }
+        }
+    }
+    if (this->TableMode != chained)
+    {
+        cout << "avg. probe:\t\t" << (sumIns ? double(sumProbe) / double(sumIns) : 0.0) << endl;
+        cout << "max. probe:\t\t" << maxProbe << endl;
+    }
+    this->printIndexStats();
+}
+
+// OUTPUT: the Bloom filter and suggestion index lines of printStats, for those that are on
+void HashMap::printIndexStats() const
+{
+    if (this->bloomBits > 0)
+    {
+        // ideal rate of a standard Bloom filter with the same bits per key; blocking costs a little more
+        double bitsPerKey = 8.0 * this->bloom.bytes() / std::max(this->bloomAdded, size_t(1));
+        int k = this->bloom.hashCount();
+        double ideal = pow(1 - exp(-k / bitsPerKey), k);
+        long rejected = this->bloomMisses + this->bloomFalse;
+        cout << "bloom bytes:\t" << this->bloom.bytes() << endl;
+        cout << "bloom fpr:\t\t" << (rejected ? double(this->bloomFalse) / rejected : 0.0)
+             << " (ideal " << ideal << ")" << endl;
+    }
+    if (this->symspellIndex)
+    {
+        cout << "suggest index:\t" << this->symspellIndex->entries() << " (prefix " << this->symspellIndex->prefix()
+             << ", distance " << this->symspellIndex->distance() << ")" << endl;
+        cout << "suggest bytes:\t" << this->symspellIndex->bytes() << endl;
+    }
+    if (this->bkTree)
+    {
+        cout << "bktree nodes:\t" << this->bkTree->nodeCount() << " (depth " << this->bkTree->depth() << ")" << endl;
+        cout << "bktree bytes:\t" << this->bkTree->bytes() << endl;
+    }
+    if (this->dawgIndex)
+    {
+        cout << "dawg states:\t" << this->dawgIndex->stateCount() << " (transitions "
+             << this->dawgIndex->transitionCount() << ")" << endl;
+        cout << "dawg bytes:\t\t" << this->dawgIndex->bytes() << endl;
+    }
+}
+
+// OUTPUT: the following values are printed to the screen, for the current hash code method:
+// hash code: name of the hash code method
+// distinct codes: # of distinct hash codes among the keys, before compression
+// bucket lengths: # of buckets holding 0, 1, 2, ... keys
+// chi-square: chi-square statistic of the bucket lengths against the Poisson distribution expected from
+// a uniform hash at the current load factor, with its degrees of freedom
+// probes (hit): average # of keys compared by a successful find, and the ideal value for a uniform hash
+// probes (miss): average # of keys compared by an unsuccessful find, and the ideal value for a uniform hash
+// Bucket lengths count keys by home bucket, so they describe the hash regardless of the table mode.
+// Nothing is printed for an empty table, while a snapshot is open or while the table is frozen.
+void HashMap::analyze() const
+{
+    static const char* names[] = {"poly", "cyclic", "simple", "custom", "wyhash", "xxh3", "fnv1a", "crc32c"};
+    vector<string_view> keys;
+    this->collectKeys(keys);
+    int m = keys.size();
+    if (this->n == 0)
+    {
+        return;
+    }
+
+    vector<int> codes(m);
+    vector<int> lengths(this->n, 0);
+    for (int i = 0; i < m; i++)
+    {
+        codes[i] = this->hashCode(keys[i]);
+        lengths[this->hashCompress(codes[i])]++;
+    }
+    std::sort(codes.begin(), codes.end());
+    int distinct = std::unique(codes.begin(), codes.end()) - codes.begin();
+
+    int maxLen = *std::max_element(lengths.begin(), lengths.end());
+    vector<int> histogram(maxLen + 1, 0);
+    for (int i = 0; i < this->n; i++)
+    {
+        histogram[lengths[i]]++;
+    }
+
+    // chi-square against Poisson(alpha); bins with fewer than 5 expected buckets are merged into the tail
+    double alpha = double(m) / double(this->n);
+    double chi = 0, expectedBelow = 0;
+    int observedBelow = 0, bins = 0;
+    double pk = exp(-alpha);
+    for (int k = 0; ; k++)
+    {
+        double expected = this->n * pk;
+        if (expected < 5 && k > alpha)
+        {
+            double tailExpected = this->n - expectedBelow;
+            double tailObserved = this->n - observedBelow;
+            if (tailExpected > 0)
+            {
+                chi += (tailObserved - tailExpected) * (tailObserved - tailExpected) / tailExpected;
+                bins++;
+            }
+            break;
+        }
+        int observed = k <= maxLen ? histogram[k] : 0;
+        chi += (observed - expected) * (observed - expected) / expected;
+        bins++;
+        expectedBelow += expected;
+        observedBelow += observed;
+        pk *= alpha / (k + 1);
+    }
+
+    // measured probes: chains are scanned from the front; open tables are probed as find does
+    double hitProbes = 0, missProbes = 0;
+    if (this->TableMode == chained)
+    {
+        for (int i = 0; i < this->n; i++)
+        {
+            hitProbes += lengths[i] * (lengths[i] + 1) / 2.0;
+            missProbes += lengths[i];
+        }
+        hitProbes /= std::max(m, 1);
+        missProbes /= this->n;
+    }
+    else if (this->TableMode == open)
+    {
+        for (int i = 0; i < this->n; i++)
+        {
+            if (this->probes[i] >= 0)
+            {
+                hitProbes += this->probes[i] + 1;
+            }
+            int d = 0;
+            while (d < this->n && this->probes[(i + d) % this->n] >= d)
+            {
+                d++;
+            }
+            missProbes += std::min(d + 1, this->n); // the slot that ends the probe is read as well
+        }
+        hitProbes /= std::max(m, 1);
+        missProbes /= this->n;
+    }
+    else
+    {
+        // in swiss mode a probe is a group: one tag compare of GROUP_WIDTH slots
+        int groups = this->n / GROUP_WIDTH;
+        for (int i = 0; i < this->n; i++)
+        {
+            if (this->ctrl[i] >= 0)
+            {
+                hitProbes += (i / GROUP_WIDTH - this->hash(this->slots[i]) / GROUP_WIDTH + groups) % groups + 1;
+            }
+        }
+        for (int g = 0; g < groups; g++)
+        {
+            int d = 1;
+            while (d < groups && !groupMatch(this->ctrl + (g + d - 1) % groups * GROUP_WIDTH, CTRL_EMPTY))
+            {
+                d++;
+            }
+            missProbes += d;
+        }
+        hitProbes /= std::max(m, 1);
+        missProbes /= groups;
+    }
+
+    double idealHit = 1 + alpha / 2, idealMiss = alpha;
+    if (this->TableMode == open)
+    {
+        idealHit = (1 + 1 / (1 - alpha)) / 2;
+        idealMiss = (1 + 1 / ((1 - alpha) * (1 - alpha))) / 2;
+    }
+    if (this->TableMode == swiss)
+    {
+        idealHit = idealMiss = 1;
+    }
+
+    cout << "hash code:\t\t" << names[this->HashCodeMethod] << endl;
+    cout << "distinct codes:\t" << distinct << endl;
+    cout << "bucket lengths:" << endl;
+    for (int k = 0; k <= maxLen; k++)
+    {
+        cout << "  " << k << ":\t\t\t" << histogram[k] << endl;
+    }
+    cout << "chi-square:\t\t" << chi << " (df " << bins - 1 << ")" << endl;
+    cout << "probes (hit):\t" << hitProbes << " (ideal " << idealHit << ")" << endl;
+    cout << "probes (miss):\t" << missProbes << " (ideal " << idealMiss << ")" << endl;
+}
+
+// INPUT: a string m representing one of the hash code implementations
+// PRECONDITION: m must be one of {"poly", "simple", "cyclic", "custom", "wyhash", "xxh3", "fnv1a", "crc32c"}
+// POSTCONDITION: the hash table will use the specified hash code function when hashing
+void HashMap::setHashCodeMethod(string m)
+{
+    this->thaw();
+    // finish any migration with the method both tables were built with
+    this->migrateStep(this->migrateN);
+    if (m == "poly")
+    {
+        this->HashCodeMethod = poly;
+    }
+
+    if (m == "simple")
+    {
+        this->HashCodeMethod = simple;
+    }
+
+    if (m == "cyclic")
+    {
+        this->HashCodeMethod = cyclic;
+    }
+
+    if (m == "custom")
+    {
+        this->HashCodeMethod = custom;
+    }
+
+    if (m == "wyhash")
+    {
+        this->HashCodeMethod = wyhash;
+    }
+
+    if (m == "xxh3")
+    {
+        this->HashCodeMethod = xxh3;
+    }
+
+    if (m == "fnv1a")
+    {
+        this->HashCodeMethod = fnv1a;
+    }
+
+    if (m == "crc32c")
+    {
+        this->HashCodeMethod = crc32;
+    }
+}
+
+// INPUT: a string m representing one of the table layouts
+// PRECONDITION: m must be one of {"chained", "open", "swiss"}
+// POSTCONDITION: the table uses the specified layout and all previous entries are rehashed into it
+void HashMap::setTableMode(string m)
+{
+    TM old = this->TableMode;
+    if (m == "chained")
+    {
+        this->TableMode = chained;
+    }
+
+    if (m == "open")
+    {
+        this->TableMode = open;
+    }
+
+    if (m == "swiss")
+    {
+        this->TableMode = swiss;
+    }
+
+    if (this->TableMode != old && this->n > 0)
+    {
+        this->resizeTable(this->n);
+    }
+}
+
+// Sets the smallest size the table may shrink to, and resizes the table to the smallest power-of-two
+// multiple of s that keeps the load factor at or below maxLoad
+// INPUT: minimum size s of the hash table
+// PRECONDITION: s is positive; otherwise it is ignored and the size is left unchanged
+void HashMap::setMinSize(int s)
+{
+    if (s < 1)
+    {
+        return;
+    }
+    this->minSize = s;
+    int target = s;
+    while (this->count > this->maxLoad * target)
+    {
+        target *= 2;
+    }
+    if (target != this->n)
+    {
+        this->resizeTable(target);
+    }
+}
+
+// INPUT: the load factor above which the table doubles in size
+// PRECONDITION: f is positive; the minimum load factor is lowered to f / 4 if it is not below f / 2,
+// so that a table that has just grown or shrunk is not immediately resized again
+void HashMap::setMaxLoadFactor(double f)
+{
+    if (f > 0)
+    {
+        this->maxLoad = f;
+    }
+    if (this->minLoad * 2 >= this->maxLoad)
+    {
+        this->minLoad = this->maxLoad / 4;
+    }
+}
+
+// INPUT: the load factor below which the table halves in size (0 disables shrinking)
+// PRECONDITION: f is below half of the maximum load factor; otherwise it is ignored
+void HashMap::setMinLoadFactor(double f)
+{
+    if (f >= 0 && f * 2 < this->maxLoad)
+    {
+        this->minLoad = f;
+    }
+}
+
+// INPUT: a string m representing how entries are moved into a resized table
+// PRECONDITION: m must be one of {"full", "incremental"}
+// POSTCONDITION: subsequent resizes of a chained table rehash all entries at once (full) or spread
+// the work over the following puts and erases (incremental)
+void HashMap::setRehashMode(string m)
+{
+    if (m == "full")
+    {
+        this->RehashMode = full;
+    }
+
+    if (m == "incremental")
+    {
+        this->RehashMode = incremental;
+    }
+}
+
+// INPUT: number of buckets k migrated by each put or erase during incremental rehashing
+// PRECONDITION: k is at least 2, so that a migration always completes before the table doubles again;
+// smaller values are ignored
+void HashMap::setRehashStep(int k)
+{
+    if (k >= 2)
+    {
+        this->rehashStep = k;
+    }
+}
+
+// INPUT: bits per key b of the Bloom filter used by check, 0 to turn it off
+// PRECONDITION: b is not negative; otherwise it is ignored
+// POSTCONDITION: the filter is rebuilt from the current keys, and its counters are reset
+void HashMap::setBloomBits(int b)
+{
+    if (b < 0)
+    {
+        return;
+    }
+    this->bloomBits = b;
+    this->bloomMisses = this->bloomFalse = 0;
+    this->bloom.reset(0, 1);
+    this->bloomCapacity = this->bloomAdded = 0;
+    if (b > 0)
+    {
+        this->rebuildBloom(0);
+    }
+}
+
+// INPUT: a lowercase word, the largest edit distance to report (SUGGEST_DISTANCE if negative, at most
+// SUGGEST_MAX_DISTANCE)
+// POSTCONDITION: out holds every dictionary word within maxDist of key, closest first and then in
+// alphabetical order. The suggestion index is built first if there is none or if it was built for a
+// smaller distance; from then on every load rebuilds it.
+void HashMap::suggest(string_view key, int maxDist, vector<Suggestion>& out)
+{
+    if (maxDist < 0)
+    {
+        maxDist = SUGGEST_DISTANCE;
+    }
+    if (maxDist > SUGGEST_MAX_DISTANCE)
+    {
+        maxDist = SUGGEST_MAX_DISTANCE;
+    }
+    out.clear();
+    this->suggestAtLoad = true;
+    if (this->SuggestBackend == bktree)
+    {
+        if (!this->bkTree)
+        {
+            this->buildSuggestions(this->suggestDistance);
+        }
+        this->bkTree->lookup(key, maxDist, out);
+        return;
+    }
+    if (this->SuggestBackend == dawg)
+    {
+        if (!this->dawgIndex)
+        {
+            this->buildSuggestions(this->suggestDistance);
+        }
+        KeyArena empty; // the words of the previous suggestions
+        this->suggestWords.swap(empty);
+        this->dawgIndex->lookup(key, maxDist, out, this->suggestWords);
+        return;
+    }
+    if (!this->symspellIndex || this->symspellIndex->distance() < maxDist)
+    {
+        this->buildSuggestions(std::max(maxDist, this->suggestDistance));
+    }
+    this->symspellIndex->lookup(key, maxDist, out);
+}
+
+// INPUT: number of leading characters of a word the suggestion index holds deletions of (at least 1)
+// POSTCONDITION: the index is rebuilt with the new prefix length, now and at every load
+void HashMap::setSuggestPrefix(int p)
+{
+    if (p < 1)
+    {
+        return;
+    }
+    this->suggestPrefix = p;
+    this->suggestAtLoad = true;
+    this->buildSuggestions(this->suggestDistance);
+}
+
+// INPUT: name of the suggestion backend: symspell (deletion index), bktree or dawg
+// POSTCONDITION: the current index is dropped; suggest() builds one for the new backend
+void HashMap::setSuggestBackend(string m)
+{
+    if (m == "symspell")
+    {
+        this->SuggestBackend = symspell;
+    }
+    else if (m == "bktree")
+    {
+        this->SuggestBackend = bktree;
+    }
+    else if (m == "dawg")
+    {
+        this->SuggestBackend = dawg;
+    }
+    else
+    {
+        return;
+    }
+    this->dropSuggestions();
+}
+
+// INPUT: the largest edit distance a SymSpell index has to answer for
+// POSTCONDITION: the index of the current backend covers the current keys
+void HashMap::buildSuggestions(int maxDist)
+{
+    vector<string_view> keys;
+    this->collectKeys(keys);
+    this->dropSuggestions();
+    if (this->SuggestBackend == bktree)
+    {
+        this->bkTree = new BKTree(keys);
+    }
+    else if (this->SuggestBackend == dawg)
+    {
+        this->dawgIndex = new Dawg(keys);
+    }
+    else
+    {
+        this->symspellIndex = new SymSpellIndex(keys, maxDist, this->suggestPrefix);
+    }
+    this->suggestDistance = maxDist;
+}
+
+// Drops the suggestion index, whose views of the keys are about to go stale
+void HashMap::dropSuggestions()
+{
+    delete this->symspellIndex;
+    this->symspellIndex = NULL;
+    delete this->bkTree;
+    this->bkTree = NULL;
+    delete this->dawgIndex;
+    this->dawgIndex = NULL;
+}
+
+HashMap::~HashMap()
+{
+    delete this->symspellIndex;
+    delete this->bkTree;
+    delete this->dawgIndex;
+    delete this->image;
+    delete[] this->table;
+    delete[] this->migrateTable;
+    delete[] this->slots;
+    delete[] this->probes;
+    delete[] this->ctrl;
+    delete[] this->inserts;
+}
+
+// Immutable dictionary stored as a finite-state transducer: the minimal DAWG of the words in which every
+// state also counts the words below it. Summing the counts of the transitions skipped on the way numbers
+// the words 0 to size() - 1 in sorted order, and that number indexes a payload per word (a frequency),
+// which makes the automaton a transducer from words to payloads. The whole FST is one flat image (a
+// header, then the arrays below) that is written to disk as is and mapped back in by open(), so a saved
+// dictionary is queried in place without being parsed.
+class Fst
+{
+public:
+    Fst();
+    ~Fst();
+    bool load(string fname);
+    void build(const char* data, size_t len);
+    bool save(string fname) const;
+    bool open(string fname);
+    int find(string_view word) const;
+    uint32_t payload(int rank) const;
+    void listPrefix(string_view prefix, size_t limit, vector<std::pair<string, uint32_t> >& out) const;
+    int size() const;
+    void printStats() const;
+private:
+    Fst(const Fst&);
+    Fst& operator=(const Fst&);
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t stateCount;
+        uint32_t transitionCount;
+        uint32_t wordCount;
+        uint32_t checksum; // crc32c of everything after the header
+        uint32_t reserved;
+    };
+    static const uint32_t VERSION = 1;
+    // the image: held in built, or mapped from file
+    vector<uint32_t> built;
+    MappedFile* file;
+    const Header* header;
+    size_t imageBytes;
+    // state s has the transitions first[s] to first[s + 1] - 1, in label order, and accepts a word if bit s
+    // of accept is set; counts[s] is the number of words accepted from s. State 0 is the start state.
+    const uint32_t* first;
+    const uint32_t* counts;
+    const uint32_t* targets;
+    const uint32_t* payloads;
+    const unsigned char* accept;
+    const char* labels;
+    bool attach(const char* image, size_t len);
+    bool accepts(uint32_t s) const;
+    void enumerate(uint32_t s, uint32_t rank, string& word, size_t limit,
+                   vector<std::pair<string, uint32_t> >& out) const;
+};
+
+Fst::Fst()
+{
+    this->file = NULL;
+    this->header = NULL;
+    this->imageBytes = 0;
+}
+
+Fst::~Fst()
+{
+    delete this->file;
+}
+
+// INPUT: name of a text file containing words, one per line, each optionally followed by whitespace and
+// its payload (a non-negative integer)
+// OUTPUT: false if the file cannot be opened
+// POSTCONDITION: the FST holds the words of the file (see build)
+bool Fst::load(string fname)
+{
+    MappedFile input;
+    if (!input.open(fname))
+    {
+        return false;
+    }
+    this->build(input.data(), input.size());
+    return true;
+}
+
+// INPUT: a buffer of len bytes in the format of load()
+// POSTCONDITION: the FST holds exactly the lowercased words of the buffer, replacing what it held before.
+// A word without a payload gets 0; a repeated word keeps the payload of its first line. Blank lines are
+// skipped.
+void Fst::build(const char* data, size_t len)
+{
+    KeyArena words;
+    vector<std::pair<string_view, uint32_t> > entries;
+    const char* end = data + len;
+    for (const char* line = data; line < end; )
+    {
+        const char* eol = (const char*) memchr(line, '\n', end - line);
+        const char* next = eol ? eol + 1 : end;
+        eol = eol ? eol : end;
+        while (eol > line && isspace((unsigned char) eol[-1]))
+        {
+            eol--;
+        }
+        // a trailing number after whitespace is the payload
+        const char* digits = eol;
+        while (digits > line && isdigit((unsigned char) digits[-1]))
+        {
+            digits--;
+        }
+        const char* wordEnd = eol;
+        uint32_t payload = 0;
+        if (digits < eol && digits > line && isspace((unsigned char) digits[-1]))
+        {
+            payload = strtoul(string(digits, eol).c_str(), NULL, 10);
+            for (wordEnd = digits; wordEnd > line && isspace((unsigned char) wordEnd[-1]); wordEnd--)
+            {
+            }
+        }
+        if (wordEnd > line) // skip blank lines
+        {
+            char* word = words.allocate(wordEnd - line);
+            memcpy(word, line, wordEnd - line);
+            entries.push_back(std::make_pair(lowercase(word, wordEnd - line), payload));
+        }
+        line = next;
+    }
+    std::stable_sort(entries.begin(), entries.end(), [](const std::pair<string_view, uint32_t>& a,
+                                                        const std::pair<string_view, uint32_t>& b)
+    {
+        return a.first < b.first;
+    });
+    vector<string_view> keys;
+    vector<uint32_t> values;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (keys.empty() || keys.back() != entries[i].first)
+        {
+            keys.push_back(entries[i].first);
+            values.push_back(entries[i].second);
+        }
+    }
+    Dawg dawg(keys);
+
+    // the words accepted from a state, children first; every state is reached by some word
+    uint32_t states = dawg.stateCount(), transitions = dawg.transitionCount();
+    vector<uint32_t> counts(states, 0);
+    vector<uint32_t> order;
+    vector<char> done(states, 0);
+    vector<std::pair<uint32_t, uint32_t> > stack(1, std::make_pair(0u, dawg.first[0]));
+    while (!stack.empty())
+    {
+        uint32_t s = stack.back().first, e = stack.back().second;
+        if (e < dawg.first[s + 1])
+        {
+            stack.back().second++;
+            if (!done[dawg.targets[e]])
+            {
+                stack.push_back(std::make_pair(dawg.targets[e], dawg.first[dawg.targets[e]]));
+            }
+            continue;
+        }
+        stack.pop_back();
+        if (done[s])
+        {
+            continue;
+        }
+        done[s] = 1;
+        counts[s] = dawg.accept[s];
+        for (e = dawg.first[s]; e < dawg.first[s + 1]; e++)
+        {
+            counts[s] += counts[dawg.targets[e]];
+        }
+    }
+
+    // lay the image out as 32-bit words: header, first, counts, targets, payloads, accept bits, labels
+    size_t headerWords = sizeof(Header) / 4;
+    size_t acceptWords = (states + 31) / 32, labelWords = (transitions + 3) / 4;
+    vector<uint32_t> image(headerWords + (states + 1) + states + transitions + keys.size() + acceptWords +
+                           labelWords, 0);
+    uint32_t* at = &image[headerWords];
+    memcpy(at, dawg.first.data(), (states + 1) * 4);
+    at += states + 1;
+    memcpy(at, counts.data(), states * 4);
+    at += states;
+    memcpy(at, dawg.targets.data(), transitions * 4);
+    at += transitions;
+    uint32_t* payloadAt = at;
+    at += keys.size();
+    for (uint32_t s = 0; s < states; s++)
+    {
+        ((unsigned char*) at)[s / 8] |= dawg.accept[s] << (s % 8);
+    }
+    at += acceptWords;
+    memcpy(at, dawg.labels.data(), transitions);
+    // keys are sorted and transitions are in label order, so the i-th key is word number i
+    memcpy(payloadAt, values.data(), values.size() * 4);
+    Header header;
+    memcpy(header.magic, "SPELLFST", 8);
+    header.version = VERSION;
+    header.stateCount = states;
+    header.transitionCount = transitions;
+    header.wordCount = keys.size();
+    header.checksum = crc32c((const char*) &image[headerWords], (image.size() - headerWords) * 4);
+    header.reserved = 0;
+    memcpy(&image[0], &header, sizeof(header));
+
+    delete this->file;
+    this->file = NULL;
+    this->built.swap(image);
+    this->attach((const char*) this->built.data(), this->built.size() * 4);
+}
+
+// INPUT: an image laid out by build(), len bytes long
+// OUTPUT: false if it is not a valid image of this version, fails its checksum, or does not describe an
+// automaton that queries can walk safely: the transitions of every state must lie within the transition
+// array in order, every target must be a state, the automaton must have no cycle, and every count must
+// be the sum of the state's accepting bit and the counts of its targets, with wordCount words from the
+// start state (so every rank indexes the payload array). The FST is then left unchanged.
+// POSTCONDITION: the FST answers queries from the image in place
+bool Fst::attach(const char* image, size_t len)
+{
+    const Header* h = (const Header*) image;
+    if (len < sizeof(Header) || memcmp(h->magic, "SPELLFST", 8) != 0 || h->version != VERSION)
+    {
+        return false;
+    }
+    uint64_t words = sizeof(Header) / 4 + (h->stateCount + 1) + uint64_t(h->stateCount) + h->transitionCount +
+                     h->wordCount + (h->stateCount + 31) / 32 + (h->transitionCount + 3) / 4;
+    if (h->stateCount == 0 || len != words * 4 ||
+        crc32c(image + sizeof(Header), len - sizeof(Header)) != h->checksum)
+    {
+        return false;
+    }
+    const uint32_t* at = (const uint32_t*) (image + sizeof(Header));
+    uint32_t states = h->stateCount, transitions = h->transitionCount;
+    const uint32_t* first = at;
+    const uint32_t* counts = first + states + 1;
+    const uint32_t* targets = counts + states;
+    const unsigned char* accept = (const unsigned char*) (targets + transitions + h->wordCount);
+    bool valid = first[0] == 0 && first[states] == transitions;
+    for (uint32_t s = 0; valid && s < states; s++)
+    {
+        valid = first[s] <= first[s + 1];
+    }
+    for (uint32_t e = 0; valid && e < transitions; e++)
+    {
+        valid = targets[e] < states;
+    }
+    // check the counts children first; a state met again while it is still on the stack closes a cycle
+    vector<char> visited(states, 0); // 1 while on the stack, 2 once its count is checked
+    vector<std::pair<uint32_t, uint32_t> > stack;
+    for (uint32_t root = 0; valid && root < states; root++)
+    {
+        if (visited[root])
+        {
+            continue;
+        }
+        visited[root] = 1;
+        stack.assign(1, std::make_pair(root, first[root]));
+        while (valid && !stack.empty())
+        {
+            uint32_t s = stack.back().first, e = stack.back().second;
+            if (e < first[s + 1])
+            {
+                stack.back().second++;
+                valid = visited[targets[e]] != 1;
+                if (valid && visited[targets[e]] == 0)
+                {
+                    visited[targets[e]] = 1;
+                    stack.push_back(std::make_pair(targets[e], first[targets[e]]));
+                }
+                continue;
+            }
+            stack.pop_back();
+            visited[s] = 2;
+            uint64_t count = (accept[s / 8] >> (s % 8)) & 1;
+            for (e = first[s]; e < first[s + 1]; e++)
+            {
+                count += counts[targets[e]];
+            }
+            valid = count == counts[s];
+        }
+    }
+    if (!valid || counts[0] != h->wordCount)
+    {
+        return false;
+    }
+    this->header = h;
+    this->imageBytes = len;
+    this->first = first;
+    this->counts = counts;
+    this->targets = targets;
+    this->payloads = targets + transitions;
+    this->accept = accept;
+    this->labels = (const char*) (this->payloads + h->wordCount + (states + 31) / 32);
+    return true;
+}
+
+// INPUT: name of the file to write
+// OUTPUT: false if there is no FST or the file cannot be written
+bool Fst::save(string fname) const
+{
+    if (!this->header)
+    {
+        return false;
+    }
+    ofstream out(fname.c_str(), ios::binary);
+    out.write((const char*) this->header, this->imageBytes);
+    return bool(out);
+}
+
+// INPUT: name of a file written by save()
+// OUTPUT: false if the file cannot be opened, is not an FST of this version or fails its checksum; the
+// FST is then left unchanged
+// POSTCONDITION: queries are answered straight from the mapped file
+bool Fst::open(string fname)
+{
+    MappedFile* mapped = new MappedFile();
+    if (!mapped->open(fname) || !this->attach(mapped->data(), mapped->size()))
+    {
+        delete mapped;
+        return false;
+    }
+    delete this->file;
+    this->file = mapped;
+    vector<uint32_t>().swap(this->built);
+    return true;
+}
+
+bool Fst::accepts(uint32_t s) const
+{
+    return (this->accept[s / 8] >> (s % 8)) & 1;
+}
+
+// INPUT: a lowercase word
+// OUTPUT: the number of the word (its rank among the words in sorted order), or -1 if it is not in the FST
+int Fst::find(string_view word) const
+{
+    if (!this->header)
+    {
+        return -1;
+    }
+    uint32_t s = 0, rank = 0;
+    for (size_t i = 0; i < word.length(); i++)
+    {
+        rank += this->accepts(s); // the word ending here sorts first
+        uint32_t e = this->first[s];
+        for (; e < this->first[s + 1] && this->labels[e] != word[i]; e++)
+        {
+            rank += this->counts[this->targets[e]];
+        }
+        if (e == this->first[s + 1])
+        {
+            return -1;
+        }
+        s = this->targets[e];
+    }
+    return this->accepts(s) ? (int) rank : -1;
+}
+
+// INPUT: the number of a word, as returned by find()
+// OUTPUT: its payload
+uint32_t Fst::payload(int rank) const
+{
+    return this->payloads[rank];
+}
+
+// INPUT: a lowercase prefix, the largest number of words to list
+// POSTCONDITION: out holds the first limit words starting with prefix, in sorted order, with their payloads
+void Fst::listPrefix(string_view prefix, size_t limit, vector<std::pair<string, uint32_t> >& out) const
+{
+    out.clear();
+    uint32_t s = 0, rank = 0;
+    for (size_t i = 0; this->header && i < prefix.length(); i++)
+    {
+        rank += this->accepts(s);
+        uint32_t e = this->first[s];
+        for (; e < this->first[s + 1] && this->labels[e] != prefix[i]; e++)
+        {
+            rank += this->counts[this->targets[e]];
+        }
+        if (e == this->first[s + 1])
+        {
+            return;
+        }
+        s = this->targets[e];
+    }
+    string word(prefix);
+    if (this->header)
+    {
+        this->enumerate(s, rank, word, limit, out);
+    }
+}
+
+// Lists the words accepted from state s, whose first word is number rank and whose prefix is word
+void Fst::enumerate(uint32_t s, uint32_t rank, string& word, size_t limit,
+                    vector<std::pair<string, uint32_t> >& out) const
+{
+    if (out.size() < limit && this->accepts(s))
+    {
+        out.push_back(std::make_pair(word, this->payloads[rank]));
+        rank++;
+    }
+    for (uint32_t e = this->first[s]; e < this->first[s + 1] && out.size() < limit; e++)
+    {
+        word.push_back(this->labels[e]);
+        this->enumerate(this->targets[e], rank, word, limit, out);
+        word.pop_back();
+        rank += this->counts[this->targets[e]];
+    }
+}
+
+int Fst::size() const
+{
+    return this->header ? this->header->wordCount : 0;
+}
+
+// OUTPUT: the following values are printed to the screen:
+// size: # of words
+// fst states: # of states and transitions of the automaton
+// fst bytes: size of the image, and whether it is mapped from a file
+void Fst::printStats() const
+{
+    cout << "size:\t\t\t" << this->size() << endl;
+    cout << "fst states:\t\t" << (this->header ? this->header->stateCount : 0) << " (transitions "
+         << (this->header ? this->header->transitionCount : 0) << ")" << endl;
+    cout << "fst bytes:\t\t" << this->imageBytes << (this->file ? " (mapped)" : "") << endl;
+}
+
+// Thread-safe dictionary made of 2^shardBits independent HashMap shards. A key's shard is picked by the
+// high bits of a hash that is independent of the one the shards use internally, and every shard has its
+// own reader-writer lock on its own cache line: any number of threads can find keys at the same time,
+// and an update only blocks readers of the shard it changes.
+class ConcurrentHashMap
+{
+public:
+    ConcurrentHashMap(int shardBits = 6);
+    ~ConcurrentHashMap();
+    bool find(string_view key) const;
+    void put(string_view key);
+    void erase(string_view key);
+    bool load(string fname);
 private:
-    enum HCM {poly, cyclic, simple, custom};
-    HCM HashCodeMethod;
-    int n;
-    list <string>** table;
-    int* inserts;
-    int hashCodePoly(string key) const;
-    int hashCodeSimple(string key) const;
-    int hashCodeCyclic(string key) const;
-    int hashCodeCustom(string key) const;
-    int hashCompress(int code) const;
-    int hash(string key) const;
-    void deleteTable(list<string>** t, int s);
+    ConcurrentHashMap(const ConcurrentHashMap&);
+    ConcurrentHashMap& operator=(const ConcurrentHashMap&);
+    static const uint64_t SHARD_SEED = 0x5eed;
+    struct alignas(64) Shard
+    {
+        mutable std::shared_mutex lock;
+        HashMap map;
+    };
+    int shardBits;
+    Shard* shards;
+    Shard& shardOf(string_view key) const;
 };
 
-HashMap::HashMap()
+// INPUT: log2 of the number of shards
+// PRECONDITION: 0 <= shardBits <= 16
+ConcurrentHashMap::ConcurrentHashMap(int shardBits)
 {
-    this->table = NULL;
-    this->inserts = NULL;
-    this->HashCodeMethod = simple;
-    n = 0;
+    this->shardBits = shardBits;
+    this->shards = new Shard[1 << shardBits];
 }
 
-// NAME: Melissa Paul
-// Hash code function using polynomial accumulation
-// INPUT: a string key which needs to be hashed
-// PRECONDITION: key is not null
-// OUTPUT: An integer representing the input key. The same key must always
-// produce the same output each time.
-int HashMap::hashCodePoly(string key) const
+// INPUT: a string key
+// OUTPUT: the shard responsible for key
+ConcurrentHashMap::Shard& ConcurrentHashMap::shardOf(string_view key) const
 {
-    int sum = 0, a = 33, j = key.length() - 1; // a is the base, j is the exponent,
-    // and key[i] - 96 is the coefficient
-    for (int i = 0; i < key.length(); i++) {
-        sum += (key[i] - 96) * pow(a, j);
-        j--;
+    uint64_t h = wyhash64(key, SHARD_SEED);
+    return this->shards[this->shardBits ? h >> (64 - this->shardBits) : 0];
+}
+
+// INPUT: a string key
+// OUTPUT: true if the key is in the dictionary
+// POSTCONDITION: only a shared lock on the key's shard is taken, so finds never wait for each other
+bool ConcurrentHashMap::find(string_view key) const
+{
+    Shard& shard = this->shardOf(key);
+    std::shared_lock<std::shared_mutex> guard(shard.lock);
+    return shard.map.find(key) >= 0;
+}
+
+// INPUT: a string key
+// POSTCONDITION: the key is in the dictionary
+void ConcurrentHashMap::put(string_view key)
+{
+    Shard& shard = this->shardOf(key);
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    shard.map.put(key);
+}
+
+// INPUT: a string key
+// POSTCONDITION: the key is not in the dictionary
+void ConcurrentHashMap::erase(string_view key)
+{
+    Shard& shard = this->shardOf(key);
+    std::unique_lock<std::shared_mutex> guard(shard.lock);
+    shard.map.erase(key);
+}
+
+// INPUT: name of a text file containing input string keys, one per line (no whitespace)
+// OUTPUT: false if the file cannot be opened
+// POSTCONDITION: all keys in the file are inserted. The keys are grouped by shard first, so every shard
+// is locked once for the whole file rather than once per key. The groups hold views into the mapped
+// file; each key is lowercased into a small buffer when it is hashed and again when it is inserted.
+bool ConcurrentHashMap::load(string fname)
+{
+    MappedFile file;
+    if (!file.open(fname))
+    {
+        return false;
     }
-    return sum;
+    vector<vector<string_view> > byShard(1 << this->shardBits);
+    string lower; // lowercase copy of one key
+    const char* end = file.data() + file.size();
+    for (const char* line = file.data(); line < end; )
+    {
+        const char* eol = (const char*) memchr(line, '\n', end - line);
+        const char* next = eol ? eol + 1 : end;
+        eol = eol ? eol : end;
+        // trim whitespace
+        while (eol > line && (eol[-1] == ' ' || eol[-1] == '\r' || eol[-1] == '\t'))
+        {
+            eol--;
+        }
+        lower.resize(eol - line);
+        lowercase(&lower[0], line, lower.length());
+        byShard[&this->shardOf(lower) - this->shards].push_back(string_view(line, eol - line));
+        line = next;
+    }
+    for (size_t s = 0; s < byShard.size(); s++)
+    {
+        std::unique_lock<std::shared_mutex> guard(this->shards[s].lock);
+        for (size_t i = 0; i < byShard[s].size(); i++)
+        {
+            lower.resize(byShard[s][i].length());
+            lowercase(&lower[0], byShard[s][i].data(), lower.length());
+            this->shards[s].map.put(lower);
+        }
+    }
+    return true;
 }
 
-// NAME: Melissa Paul
-// Hash code function using a simple linear summation
-// INPUT: a string key which needs to be hashed
-// PRECONDITION: key is not null
-// OUTPUT: An integer representing the input key. The same key must always
-// produce the same output each time.
-int HashMap::hashCodeSimple(string key) const
+ConcurrentHashMap::~ConcurrentHashMap()
 {
-    int sum = 0;
-    for (int i = 0; i < key.length(); i++) {
-        sum += key[i] - 96; // Lowercase decimal value in ASCII - 96 = value in alphabet
-    } // e.g., a = 1, b = 2,..., z = 26
-    return sum;
+    delete[] this->shards;
 }
 
-// NAME: Melissa Paul
-// Hash code function using a cyclic bit shift
-// INPUT: a string key which needs to be hashed
-// PRECONDITION: key is not null
-// OUTPUT: An integer representing the input key. The same key must always
-// produce the same output each time.
-int HashMap::hashCodeCyclic(string key) const // Based off pseudocode from p. 379 in textbook
+// Dictionary whose find takes no lock and does no atomic operation besides one acquire load of the
+// current table, for read-mostly traffic shared by many threads (RCU: read-copy-update).
+// The table is a directory of 2^segmentBits segments, each a small immutable open addressing table
+// holding its own copy of its keys. Writers are serialized by a mutex; put and erase build a new copy of
+// the one segment they change and of the directory, then publish the new directory with a release store,
+// so readers see either the old or the new version, never a mix, and never wait for a writer or a resize.
+// Replaced segments and directories are freed by quiescent-state based reclamation: every reader thread
+// registers, and calls quiescent() whenever it holds no pointer into the map (e.g. between batches of
+// finds); a retired version is freed once every registered reader has been quiescent since it was
+// replaced.
+class RcuHashMap
 {
-    unsigned int sum = 0;
-    for (int i = 0; i < key.length(); i++) { // 5-bit cyclic shift we form bitwise or
-        sum = (sum << 5) | (sum >> 27); // of a 5 - bit left shift and a 27 - bit right shift
-        sum += (unsigned int) key[i]; // Add string character key[i]
+public:
+    static const int MAX_READERS = 256;
+    RcuHashMap(int segmentBits = 8);
+    ~RcuHashMap();
+    bool find(string_view key) const;
+    void put(string_view key);
+    void erase(string_view key);
+    bool load(string fname);
+    void resizeTable(int segmentBits);
+    int registerReader();
+    void quiescent(int reader);
+    void unregisterReader(int reader);
+private:
+    RcuHashMap(const RcuHashMap&);
+    RcuHashMap& operator=(const RcuHashMap&);
+    static const uint64_t RCU_SEED = 0x7c0;
+    static const uint32_t RCU_EMPTY = 0xFFFFFFFFu;
+    static const size_t SEGMENT_KEYS = 1024; // average keys per segment above which segments double
+    struct Segment
+    {
+        uint32_t mask; // # of slots - 1
+        vector<uint32_t> offsets; // offset of each slot's key in keys, RCU_EMPTY if the slot is empty
+        vector<uint32_t> lengths;
+        string keys;
+    };
+    struct Table
+    {
+        int segmentBits;
+        size_t count;
+        vector<Segment*> segments;
+    };
+    struct Retired
+    {
+        uint64_t epoch; // freed once every reader has been quiescent at this epoch or later
+        Table* table;
+        Segment* segment;
+    };
+    struct alignas(64) Reader
+    {
+        std::atomic<bool> inUse;
+        std::atomic<uint64_t> seen; // epoch of the reader's last quiescent state
+    };
+    std::atomic<Table*> current;
+    std::atomic<uint64_t> epoch;
+    std::mutex writeLock;
+    vector<Retired> retired;
+    Reader readers[MAX_READERS];
+    static uint64_t hash(string_view key);
+    static uint32_t segmentOf(uint64_t h, int segmentBits);
+    static int findIn(const Segment* seg, uint64_t h, string_view key);
+    static Segment* buildSegment(const vector<string_view>& keys);
+    static void segmentKeys(const Segment* seg, vector<string_view>& keys);
+    void publish(Table* t, const vector<Segment*>& oldSegments);
+    void reclaim();
+};
+
+const int RcuHashMap::MAX_READERS;
+const size_t RcuHashMap::SEGMENT_KEYS;
+const uint32_t RcuHashMap::RCU_EMPTY;
+
+// INPUT: log2 of the initial number of segments
+// PRECONDITION: 0 <= segmentBits <= 24
+RcuHashMap::RcuHashMap(int segmentBits)
+{
+    Table* t = new Table();
+    t->segmentBits = segmentBits;
+    t->count = 0;
+    vector<string_view> none;
+    for (int s = 0; s < (1 << segmentBits); s++)
+    {
+        t->segments.push_back(buildSegment(none));
+    }
+    this->current.store(t);
+    this->epoch.store(1);
+    for (int r = 0; r < MAX_READERS; r++)
+    {
+        this->readers[r].inUse.store(false);
+        this->readers[r].seen.store(0);
     }
-    return int(sum);
 }
 
-// NAME: Melissa Paul
-// Hash code function using an exponential summation.
-// INPUT: a string key which needs to be hashed
-// PRECONDITION: key is not null
-// OUTPUT: An integer representing the input key. The same key must always
-// produce the same output each time.
-int HashMap::hashCodeCustom(string key) const
+uint64_t RcuHashMap::hash(string_view key)
 {
-    int sum = 0, j = key.length();
-    for (int i = 0; i < key.length(); i++) {
-        sum += pow((key[i] - 92), j); // Exponential sum
-        j--;
+    return wyhash64(key, RCU_SEED);
+}
+
+// OUTPUT: the segment of a key with hash h, taken from the high bits of h
+uint32_t RcuHashMap::segmentOf(uint64_t h, int segmentBits)
+{
+    return segmentBits ? h >> (64 - segmentBits) : 0;
+}
+
+// INPUT: a segment, hash h of key, a string key
+// OUTPUT: index of the slot of seg holding key, or -1; slots are probed linearly from the low bits of h
+int RcuHashMap::findIn(const Segment* seg, uint64_t h, string_view key)
+{
+    for (uint32_t i = (uint32_t) h & seg->mask; seg->offsets[i] != RCU_EMPTY; i = (i + 1) & seg->mask)
+    {
+        if (seg->lengths[i] == key.length() && memcmp(&seg->keys[seg->offsets[i]], key.data(), key.length()) == 0)
+        {
+            return i;
+        }
     }
-    return sum;
+    return -1;
 }
 
-// NAME: Melissa Paul
-// INPUT: an integer hash code representing a string key
-// OUTPUT: An integer in the range [0-n] where n is the size of the hash table.
-// The same input hash code must produce the same output each time.
-int HashMap::hashCompress(int code) const
-{ // a ("scale") = 7, b ("shift") = 103, N = 109345121
-    return (abs((7 * code) + 103) % 109345121) % this->n; // h(k) = | ak + b | mod N
+// INPUT: distinct keys
+// OUTPUT: a new segment holding copies of keys, with a power of two of at least twice as many slots
+RcuHashMap::Segment* RcuHashMap::buildSegment(const vector<string_view>& keys)
+{
+    Segment* seg = new Segment();
+    uint32_t slots = 8;
+    size_t bytes = 0;
+    while (slots < 2 * keys.size())
+    {
+        slots *= 2;
+    }
+    for (size_t k = 0; k < keys.size(); k++)
+    {
+        bytes += keys[k].length();
+    }
+    seg->mask = slots - 1;
+    seg->offsets.assign(slots, RCU_EMPTY);
+    seg->lengths.assign(slots, 0);
+    seg->keys.reserve(bytes);
+    for (size_t k = 0; k < keys.size(); k++)
+    {
+        uint32_t i = (uint32_t) hash(keys[k]) & seg->mask;
+        while (seg->offsets[i] != RCU_EMPTY)
+        {
+            i = (i + 1) & seg->mask;
+        }
+        seg->offsets[i] = seg->keys.length();
+        seg->lengths[i] = keys[k].length();
+        seg->keys.append(keys[k].data(), keys[k].length());
+    }
+    return seg;
 }
 
-// Function that consistently maps any given input string key to an integer corresponding to a bucket in the
-// hash table.
-// The hash code method used depends on the current value of this.HashCodeMethod
-// INPUT: a string key which needs to be hashed
-// OUTPUT: An integer in the range [0-n] where n is the size of the hash table.
-// The same input string key must produce the same output each time.
-int HashMap::hash(string key) const
+// OUTPUT: views of the keys of seg are appended to keys
+void RcuHashMap::segmentKeys(const Segment* seg, vector<string_view>& keys)
 {
-    int code;
-    if (this->HashCodeMethod == simple)
+    for (uint32_t i = 0; i <= seg->mask; i++)
     {
-        code = this->hashCodeSimple(key);
+        if (seg->offsets[i] != RCU_EMPTY)
+        {
+            keys.push_back(string_view(&seg->keys[seg->offsets[i]], seg->lengths[i]));
+        }
+    }
+}
+
+// INPUT: a string key
+// OUTPUT: true if the key is in the dictionary
+// PRECONDITION: the calling thread is a registered reader (or the only thread using the map)
+bool RcuHashMap::find(string_view key) const
+{
+    const Table* t = this->current.load(std::memory_order_acquire);
+    uint64_t h = hash(key);
+    return findIn(t->segments[segmentOf(h, t->segmentBits)], h, key) >= 0;
+}
+
+// INPUT: a string key
+// POSTCONDITION: the key is in the dictionary; the segments double once they average SEGMENT_KEYS keys
+void RcuHashMap::put(string_view key)
+{
+    std::unique_lock<std::mutex> guard(this->writeLock);
+    Table* t = this->current.load(std::memory_order_relaxed);
+    uint64_t h = hash(key);
+    uint32_t s = segmentOf(h, t->segmentBits);
+    if (findIn(t->segments[s], h, key) >= 0)
+    {
+        return;
     }
-    if (this->HashCodeMethod == poly)
+    vector<string_view> keys;
+    segmentKeys(t->segments[s], keys);
+    keys.push_back(key);
+    Table* next = new Table(*t);
+    next->count++;
+    next->segments[s] = buildSegment(keys);
+    this->publish(next, vector<Segment*>(1, t->segments[s]));
+    // once the lock is dropped another writer may replace and free next
+    int bits = next->segmentBits;
+    if (next->count > SEGMENT_KEYS << bits && bits < 24)
     {
-        code = this->hashCodePoly(key);
+        guard.unlock();
+        this->resizeTable(bits + 1);
+    }
+}
+
+// INPUT: a string key
+// POSTCONDITION: the key is not in the dictionary
+void RcuHashMap::erase(string_view key)
+{
+    std::unique_lock<std::mutex> guard(this->writeLock);
+    Table* t = this->current.load(std::memory_order_relaxed);
+    uint64_t h = hash(key);
+    uint32_t s = segmentOf(h, t->segmentBits);
+    if (findIn(t->segments[s], h, key) < 0)
+    {
+        return;
     }
-    if (this->HashCodeMethod == cyclic)
+    vector<string_view> keys;
+    segmentKeys(t->segments[s], keys);
+    keys.erase(std::find(keys.begin(), keys.end(), key));
+    Table* next = new Table(*t);
+    next->count--;
+    next->segments[s] = buildSegment(keys);
+    this->publish(next, vector<Segment*>(1, t->segments[s]));
+}
+
+// INPUT: name of a text file containing input string keys, one per line (no whitespace)
+// OUTPUT: false if the file cannot be opened
+// POSTCONDITION: all non-empty keys in the file are inserted. Every segment that gains keys is rebuilt
+// once and the whole file is published as a single new version. New keys are kept as views into the
+// mapped file and lowercased into a small buffer: once per key to hash it, then one segment at a time
+// when that segment is rebuilt.
+bool RcuHashMap::load(string fname)
+{
+    MappedFile file;
+    if (!file.open(fname))
     {
-        code = this->hashCodeCyclic(key);
+        return false;
     }
-    if (this->HashCodeMethod == custom)
+    std::unique_lock<std::mutex> guard(this->writeLock);
+    Table* t = this->current.load(std::memory_order_relaxed);
+    vector<vector<string_view> > added(t->segments.size());
+    string lower; // lowercase copy of one key, then of the new keys of one segment
+    const char* end = file.data() + file.size();
+    for (const char* line = file.data(); line < end; )
     {
-        code = this->hashCodeCustom(key);
+        const char* eol = (const char*) memchr(line, '\n', end - line);
+        const char* next = eol ? eol + 1 : end;
+        eol = eol ? eol : end;
+        // trim whitespace
+        while (eol > line && (eol[-1] == ' ' || eol[-1] == '\r' || eol[-1] == '\t'))
+        {
+            eol--;
+        }
+        lower.resize(eol - line);
+        lowercase(&lower[0], line, lower.length());
+        uint64_t h = hash(lower);
+        uint32_t s = segmentOf(h, t->segmentBits);
+        if (eol > line && findIn(t->segments[s], h, lower) < 0)
+        {
+            added[s].push_back(string_view(line, eol - line));
+        }
+        line = next;
+    }
+    Table* next = new Table(*t);
+    vector<Segment*> replaced;
+    for (size_t s = 0; s < added.size(); s++)
+    {
+        if (added[s].empty())
+        {
+            continue;
+        }
+        // buildSegment copies the keys, so the buffer can be reused by the next segment
+        size_t bytes = 0;
+        for (size_t i = 0; i < added[s].size(); i++)
+        {
+            bytes += added[s][i].length();
+        }
+        lower.resize(bytes);
+        char* key = &lower[0];
+        for (size_t i = 0; i < added[s].size(); i++)
+        {
+            lowercase(key, added[s][i].data(), added[s][i].length());
+            added[s][i] = string_view(key, added[s][i].length());
+            key += added[s][i].length();
+        }
+        std::sort(added[s].begin(), added[s].end());
+        added[s].erase(std::unique(added[s].begin(), added[s].end()), added[s].end());
+        next->count += added[s].size();
+        segmentKeys(t->segments[s], added[s]);
+        next->segments[s] = buildSegment(added[s]);
+        replaced.push_back(t->segments[s]);
+    }
+    this->publish(next, replaced);
+    // once the lock is dropped another writer may replace and free next
+    int oldBits = next->segmentBits;
+    int bits = oldBits;
+    while (next->count > SEGMENT_KEYS << bits && bits < 24)
+    {
+        bits++;
+    }
+    guard.unlock();
+    if (bits != oldBits)
+    {
+        this->resizeTable(bits);
     }
-    return this->hashCompress(code) % this->n;
+    return true;
+}
+
+// Grows the directory once the segments average more than SEGMENT_KEYS keys. put and load decide to grow
+// before they give up the writer lock, so the current version is checked again here: if another writer
+// has already grown it, or the keys no longer exceed the threshold, nothing is rebuilt.
+// INPUT: log2 of the new number of segments
+// PRECONDITION: 0 <= segmentBits <= 24
+// POSTCONDITION: unless the table already has at least segmentBits bits or needs no growth, every key is
+// rehashed into a new set of segments, published at once; readers keep using the previous version until
+// then and never wait
+void RcuHashMap::resizeTable(int segmentBits)
+{
+    std::unique_lock<std::mutex> guard(this->writeLock);
+    Table* t = this->current.load(std::memory_order_relaxed);
+    if (t->segmentBits >= segmentBits || t->count <= SEGMENT_KEYS << t->segmentBits)
+    {
+        return;
+    }
+    vector<vector<string_view> > keys(1 << segmentBits);
+    vector<string_view> old;
+    for (size_t s = 0; s < t->segments.size(); s++)
+    {
+        old.clear();
+        segmentKeys(t->segments[s], old);
+        for (size_t k = 0; k < old.size(); k++)
+        {
+            keys[segmentOf(hash(old[k]), segmentBits)].push_back(old[k]);
+        }
+    }
+    Table* next = new Table();
+    next->segmentBits = segmentBits;
+    next->count = t->count;
+    for (size_t s = 0; s < keys.size(); s++)
+    {
+        next->segments.push_back(buildSegment(keys[s]));
+    }
+    this->publish(next, t->segments);
+}
+
+// Makes t the current version and retires the previous directory and the segments t no longer uses
+// PRECONDITION: writeLock is held
+void RcuHashMap::publish(Table* t, const vector<Segment*>& oldSegments)
+{
+    Table* old = this->current.load(std::memory_order_relaxed);
+    this->current.store(t, std::memory_order_release);
+    // readers that are quiescent at the new epoch or later can no longer hold the old version
+    uint64_t e = this->epoch.fetch_add(1) + 1;
+    this->retired.push_back(Retired{e, old, NULL});
+    for (size_t i = 0; i < oldSegments.size(); i++)
+    {
+        this->retired.push_back(Retired{e, NULL, oldSegments[i]});
+    }
+    this->reclaim();
+}
+
+// Frees every retired version that no registered reader can still be using
+// PRECONDITION: writeLock is held
+void RcuHashMap::reclaim()
+{
+    uint64_t oldest = UINT64_MAX;
+    for (int r = 0; r < MAX_READERS; r++)
+    {
+        if (this->readers[r].inUse.load())
+        {
+            oldest = std::min(oldest, this->readers[r].seen.load());
+        }
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < this->retired.size(); i++)
+    {
+        if (this->retired[i].epoch <= oldest)
+        {
+            delete this->retired[i].table;
+            delete this->retired[i].segment;
+        }
+        else
+        {
+            this->retired[kept++] = this->retired[i];
+        }
+    }
+    this->retired.resize(kept);
+}
+
+// OUTPUT: id of a new reader slot for the calling thread, or -1 if all MAX_READERS slots are taken
+// POSTCONDITION: the reader is registered as quiescent at the current epoch
+int RcuHashMap::registerReader()
+{
+    for (int r = 0; r < MAX_READERS; r++)
+    {
+        bool expected = false;
+        if (this->readers[r].inUse.compare_exchange_strong(expected, true))
+        {
+            this->readers[r].seen.store(this->epoch.load());
+            return r;
+        }
+    }
+    return -1;
+}
+
+// Declares that the reader holds no pointer into the map, so versions replaced until now can be freed
+// INPUT: id returned by registerReader
+void RcuHashMap::quiescent(int reader)
+{
+    this->readers[reader].seen.store(this->epoch.load());
+}
+
+// INPUT: id returned by registerReader
+// POSTCONDITION: the reader no longer holds back reclamation, and its slot can be reused
+void RcuHashMap::unregisterReader(int reader)
+{
+    this->readers[reader].inUse.store(false);
+}
+
+RcuHashMap::~RcuHashMap()
+{
+    Table* t = this->current.load();
+    for (size_t s = 0; s < t->segments.size(); s++)
+    {
+        delete t->segments[s];
+    }
+    delete t;
+    for (size_t i = 0; i < this->retired.size(); i++)
+    {
+        delete this->retired[i].table;
+        delete this->retired[i].segment;
+    }
+}
+
+// Benchmark support: heap allocations made by the running thread are counted so the benchmark can
+// report allocations per checked token.
+thread_local long allocCount = 0;
+
+void* operator new(size_t size)
+{
+    allocCount++;
+    void* p = malloc(size ? size : 1);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+// the nothrow form (used by std::stable_sort's temporary buffer) must come from the same heap
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    allocCount++;
+    return malloc(size ? size : 1);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    free(p);
 }
 
-// INPUT: a string key
-// OUTPUT: If the key exists in the table, return the index of the bucket containing the key
-// Otherwise, return -1
-int HashMap::find(string key) const
+void operator delete(void* p, size_t) noexcept
 {
-    // find the right bucket
-    int bucketIdx = this->hash(key);
+    free(p);
+}
 
-    // find the key inside bucket
-    list<string>::iterator it;
-    list<string>::iterator bucketBegin = this->table[bucketIdx]->begin();
-    list<string>::iterator bucketEnd = this->table[bucketIdx]->end();
-    it = std::find(bucketBegin, bucketEnd, key);
-    if (it != bucketEnd)
-    {
-        return bucketIdx;
-    }
-    else
-    {
-        return -1;
-    }
+// xorshift64* generator, so that synthetic dictionaries are the same on every run
+uint64_t benchRandom(uint64_t& state)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1Dull;
 }
 
-// NAME: Melissa Paul
-// INPUT: a string key
-// PRECONDITION: Key is not null and either exists in the table or needs to be inserted.
-// POSTCONDITION: Key is hashed and placed at the bottom of the appropriate bucket in the hash table.
-void HashMap::put(string key)
+// OUTPUT: a random lowercase word of 3 to 14 letters
+string benchWord(uint64_t& state)
 {
-    int bucketIdx = this->find(key); // Look if key already in table
-    if (bucketIdx == -1) { // If not found, insert
-        bucketIdx = this->hash(key);
-        this->table[bucketIdx]->push_back(key); // don't forget to update this->inserts
-        this->inserts[bucketIdx]++;
-    } // else, do nothing (no value to update)
+    uint64_t r = benchRandom(state);
+    string word(3 + r % 12, 'a');
+    for (size_t i = 0; i < word.length(); i++)
+    {
+        word[i] = 'a' + benchRandom(state) % 26;
+    }
+    return word;
 }
 
-// NAME: Melissa Paul
-// INPUT: a string key
-// PRECONDITION: Key is not null and either is or isn't in the table.
-// POSTCONDITION: Key is removed from the table if it existed; otherwise, nothing happens if the key
-// wasn't in the table.
-void HashMap::erase(string key)
+// OUTPUT: seconds elapsed since start
+double benchSeconds(std::chrono::steady_clock::time_point start)
 {
-    int bucketIdx = this->find(key); // Look if key is in table
-    if (bucketIdx) { // If found, remove and update this->inserts
-        this->table[bucketIdx]->remove(key);
-        this->inserts[bucketIdx]--;
-    } // else, do nothing
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 }
 
-// Resizes the array of lists representing the hash table, then rehashes all existing entries into the new table
-// INPUT: new size s of the hash table
-// PRECONDITION: s is positive
-// POSTCONDITION: the hash table is now size s, and all previous entries exist in the new table
-void HashMap::resizeTable(int s)
+// Runs one benchmark configuration and appends one CSV row to out:
+// words, hash_code, table, load_factor, size: the configuration and the resulting table size
+// load_wps: words per second loaded from a dictionary file by HashMap::load
+// find_hit_ns / find_miss_ns: average time of a successful / unsuccessful find
+// put_ns / erase_ns: average time to erase and re-insert a dictionary word
+// resize_ms: time to resize the loaded table to twice its size
+// check_tps: tokens per second through the check command's tokenizer and lookup
+// check_allocs: heap allocations per checked token
+// bloom_check_tps: check_tps with a 10 bits/key Bloom filter consulted before the table
+void benchConfig(ostream& out, const string& dictFile, const vector<string>& hits, const vector<string>& misses,
+                 string& text, int tokens, int words, string method, string mode, double loadFactor)
 {
-    // remember old table
-    list<string>** oldTable = this->table;
-    int old_n = this->n;
-    // reset stats
-    delete[] this->inserts;
-    this->inserts = new int[s];
-    for (int i = 0; i < s; i++)
+    HashMap H;
+    H.setHashCodeMethod(method);
+    H.setTableMode(mode);
+    H.setMaxLoadFactor(0.9);
+    H.setMinLoadFactor(0);
+    H.setMinSize(int(words / loadFactor) + 1);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    H.load(dictFile);
+    double loadTime = benchSeconds(start);
+    int size = H.size();
+
+    long found = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < hits.size(); i++)
     {
-        this->inserts[i] = 0;
+        found += H.find(hits[i]) >= 0;
     }
-    // initialize new table
-    this->n = s;
-    this->table = new list<string> * [s];
-    for (int i = 0; i < s; i++)
+    double hitTime = benchSeconds(start);
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < misses.size(); i++)
     {
-        this->table[i] = new list<string>;
+        found += H.find(misses[i]) >= 0;
     }
-    // re-insert everything from the old table into the new one
-    if (oldTable)
+    double missTime = benchSeconds(start);
+
+    size_t updates = std::min(hits.size(), size_t(words / 10 + 1));
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < updates; i++)
     {
-        for (int i = 0; i < old_n; i++)
-        {
-            list<string>* curList = oldTable[i];
-            for (list<string>::iterator it = curList->begin(); it != curList->end(); it++)
-            {
-                this->put(*it);
-            }
-        }
-        this->deleteTable(oldTable, old_n);
+        H.erase(hits[i]);
     }
-}
-
-// C++ only: deletes the current hash table from memory
-// INPUT: (optional) pointer to table to be deleted, (optional) size of that table
-void HashMap::deleteTable(list<string>** t = NULL, int s = 0)
-{
-// default values
-    if (!t)
+    double eraseTime = benchSeconds(start);
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < updates; i++)
     {
-        t = this->table;
+        H.put(hits[i]);
     }
+    double putTime = benchSeconds(start);
 
-    if (s == 0)
+    // the same tokenizing loop as the check command, on a fresh copy of the text
+    string line = text;
+    long misspelled = 0;
+    long allocsBefore = allocCount;
+    start = std::chrono::steady_clock::now();
+    size_t end = 0;
+    for (size_t tokenPos = 0; tokenPos < line.length(); tokenPos = end + 1)
     {
-        s = this->n;
+        end = std::min(line.find(' ', tokenPos), line.length());
+        string_view token = lowercase(&line[tokenPos], end - tokenPos);
+        misspelled += H.find(token) < 0;
     }
+    double checkTime = benchSeconds(start);
+    long checkAllocs = allocCount - allocsBefore;
 
-    for (int i = 0; i < s; i++)
+    // again through check() with a 10 bits/key Bloom filter in front of the table
+    H.setBloomBits(10);
+    line = text;
+    start = std::chrono::steady_clock::now();
+    for (size_t tokenPos = 0; tokenPos < line.length(); tokenPos = end + 1)
     {
-        delete t[i];
+        end = std::min(line.find(' ', tokenPos), line.length());
+        string_view token = lowercase(&line[tokenPos], end - tokenPos);
+        misspelled += !H.check(token);
     }
+    double bloomTime = benchSeconds(start);
+    H.setBloomBits(0);
 
-    delete t;
-}
+    start = std::chrono::steady_clock::now();
+    H.resizeTable(2 * size);
+    double resizeTime = benchSeconds(start);
 
-// OUTPUT: size of the hash table
-int HashMap::size() const
-{
-    return this->n;
+    out << words << "," << method << "," << mode << "," << loadFactor << "," << size << ","
+        << words / loadTime << "," << hitTime * 1e9 / hits.size() << "," << missTime * 1e9 / misses.size() << ","
+        << putTime * 1e9 / updates << "," << eraseTime * 1e9 / updates << "," << resizeTime * 1e3 << ","
+        << tokens / checkTime << "," << double(checkAllocs) / tokens << "," << tokens / bloomTime << endl;
+    // keep the lookups from being optimized away
+    if (found + misspelled < 0)
+    {
+        cout << found << misspelled;
+    }
 }
 
-// OUTPUT: the contents of every bucket in the hash table are printed to the screen, one line per bucket
-void HashMap::print() const
+// Benchmarks every hash code method and table mode at several load factors, over synthetic dictionaries
+// of 1k, 10k, 100k, ... words up to maxWords, and writes the results as CSV (see benchConfig).
+// The legacy hash codes are only run up to 100k words (simple only up to 10k, since it has a few hundred
+// distinct codes), because their collisions make larger dictionaries take minutes per configuration.
+// INPUT: name of the CSV file to write, largest dictionary size
+void runBenchmark(string outFile, int maxWords)
 {
-    for (int i = 0; i < this->n; i++)
+    static const char* methods[] = {"wyhash", "xxh3", "fnv1a", "crc32c", "cyclic", "poly", "custom", "simple"};
+    static const long methodMaxWords[] = {0, 0, 0, 0, 100000, 100000, 100000, 10000};
+    static const char* modes[] = {"chained", "open", "swiss"};
+    static const double loadFactors[] = {0.5, 0.75, 0.85};
+    ofstream out(outFile.c_str());
+    out << "words,hash_code,table,load_factor,size,load_wps,find_hit_ns,find_miss_ns,put_ns,erase_ns,"
+        << "resize_ms,check_tps,check_allocs,bloom_check_tps" << endl;
+    string dictFile = outFile + ".words";
+    for (long words = 1000; words <= maxWords; words *= 10)
     {
-        list<string>* curList = this->table[i];
-        cout << i << ":\t";
-        for (list<string>::iterator it = curList->begin(); it != curList->end(); it++)
+        // synthetic dictionary, hit and miss samples, and a check text with 3 correct words in 4
+        uint64_t state = 0x9E3779B97F4A7C15ull ^ words;
+        vector<string> dict(words);
+        ofstream dictOut(dictFile.c_str());
+        for (long i = 0; i < words; i++)
         {
-            cout << *it << "\t";
+            dict[i] = benchWord(state);
+            dictOut << dict[i] << "\n";
         }
-        cout << endl;
+        dictOut.close();
+        HashMap reference;
+        for (long i = 0; i < words; i++)
+        {
+            reference.put(dict[i]);
+        }
+        int samples = 100000;
+        vector<string> hits(samples), misses;
+        for (int i = 0; i < samples; i++)
+        {
+            hits[i] = dict[benchRandom(state) % words];
+        }
+        while ((int) misses.size() < samples)
+        {
+            string word = benchWord(state);
+            if (reference.find(word) < 0)
+            {
+                misses.push_back(word);
+            }
+        }
+        string text;
+        int tokens = 200000;
+        for (int i = 0; i < tokens; i++)
+        {
+            text += (i % 4 == 3 ? misses[i % samples] : hits[i % samples]);
+            text += (i + 1 < tokens ? " " : "");
+        }
+
+        for (int m = 0; m < 8; m++)
+        {
+            if (methodMaxWords[m] && words > methodMaxWords[m])
+            {
+                continue;
+            }
+            for (int t = 0; t < 3; t++)
+            {
+                for (int l = 0; l < 3; l++)
+                {
+                    benchConfig(out, dictFile, hits, misses, text, tokens, words, methods[m], modes[t],
+                                loadFactors[l]);
+                }
+            }
+        }
+        cout << "benchmarked " << words << " words" << endl;
     }
+    remove(dictFile.c_str());
 }
 
-// INPUT: a text file containing input string keys, one per line (no whitespace)
-// PRECONDITION: the current hash table has been initalized (resized)
-// POSTCONDITION: all keys in the input file are inserted into the hash table
-void HashMap::load(ifstream& file)
+// Measures find throughput of the concurrent dictionaries over a synthetic dictionary of words keys while
+// one writer thread keeps erasing and re-inserting dictionary words. Each configuration runs for half a
+// second and writes one CSV row:
+// threads: number of reader threads (1, 2, 4, ... up to maxThreads)
+// map: "shards=64" (ConcurrentHashMap), "shards=1" (a single lock around one table, for comparison)
+// or "rcu" (RcuHashMap; readers declare a quiescent state after every 256 finds)
+// reads_per_sec: finds per second summed over all readers (half of them hits, half misses)
+// writes_per_sec: puts and erases per second done by the writer meanwhile
+// INPUT: name of the CSV file to write, largest number of reader threads, dictionary size
+void runThreadBenchmark(string outFile, int maxThreads, int words)
 {
-    string line;
-    while (getline(file, line))
+    ofstream out(outFile.c_str());
+    out << "threads,map,reads_per_sec,writes_per_sec" << endl;
+    uint64_t state = 0x9E3779B97F4A7C15ull ^ words;
+    vector<string> dict(words), queries(200000);
+    string dictFile = outFile + ".words";
+    ofstream dictOut(dictFile.c_str());
+    for (int i = 0; i < words; i++)
     {
-        line = lowercase(line);
-        // trim whitespace
-        line.erase(line.find_last_not_of(" \n\r\t") + 1);
-        this->put(line);
+        dict[i] = benchWord(state);
+        dictOut << dict[i] << "\n";
+    }
+    dictOut.close();
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        queries[i] = i % 2 ? benchWord(state) : dict[benchRandom(state) % words];
     }
-}
 
-// OUTPUT: the following values are printed to the screen:
-// size: size of the hash table
-// inserts: # of insertions into the hash table
-// load factor: load factor of the table (inserts/size)
-// collisions: # of collisions encountered during insertions
-// max. bucket: # of keys in the largest bucket
-void HashMap::printStats() const
-{
-    int sumIns = std::accumulate(this->inserts, this->inserts + this->n, 0);
-    int* collisions = new int[this->n];
-    for (int i = 0; i < this->n; i++)
+    static const char* maps[] = {"shards=64", "shards=1", "rcu"};
+    for (int m = 0; m < 3; m++)
     {
-        collisions[i] = std::max(this->inserts[i] - 1, 0);
+        ConcurrentHashMap* C = m < 2 ? new ConcurrentHashMap(m == 0 ? 6 : 0) : NULL;
+        RcuHashMap* R = m == 2 ? new RcuHashMap() : NULL;
+        if (C)
+        {
+            C->load(dictFile);
+        }
+        else
+        {
+            R->load(dictFile);
+        }
+        for (int threads = 1; threads <= maxThreads; threads *= 2)
+        {
+            std::atomic<bool> stop(false);
+            std::atomic<long> reads(0);
+            long writes = 0;
+            vector<std::thread> readers;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int t = 0; t < threads; t++)
+            {
+                readers.push_back(std::thread([C, R, &queries, &stop, &reads, t]()
+                {
+                    long done = 0, found = 0;
+                    int reader = R ? R->registerReader() : 0;
+                    for (size_t i = t * 7919; !stop.load(std::memory_order_relaxed); done += 256)
+                    {
+                        for (int k = 0; k < 256; k++, i++)
+                        {
+                            found += R ? R->find(queries[i % queries.size()]) : C->find(queries[i % queries.size()]);
+                        }
+                        if (R)
+                        {
+                            R->quiescent(reader);
+                        }
+                    }
+                    if (R)
+                    {
+                        R->unregisterReader(reader);
+                    }
+                    reads += done + (found < 0);
+                }));
+            }
+            std::thread writer([C, R, &dict, &stop, &writes]()
+            {
+                for (size_t i = 0; !stop.load(std::memory_order_relaxed); i++, writes += 2)
+                {
+                    if (C)
+                    {
+                        C->erase(dict[i % dict.size()]);
+                        C->put(dict[i % dict.size()]);
+                    }
+                    else
+                    {
+                        R->erase(dict[i % dict.size()]);
+                        R->put(dict[i % dict.size()]);
+                    }
+                }
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            stop = true;
+            for (int t = 0; t < threads; t++)
+            {
+                readers[t].join();
+            }
+            writer.join();
+            double elapsed = benchSeconds(start);
+            out << threads << "," << maps[m] << "," << reads / elapsed << "," << writes / elapsed << endl;
+        }
+        delete C;
+        delete R;
     }
-    int sumColl = std::accumulate(collisions, collisions + this->n, 0);
-    cout << "size:\t\t\t" << this->n << endl;
-    cout << "inserts:\t\t" << sumIns << endl;
-    cout << "load factor:\t" << double(sumIns) / double(this->n) << endl;
-    cout << "collisions:\t\t" << sumColl << endl;
-    cout << "max. bucket:\t" << *std::max_element(this->inserts, this->inserts + this->n) << endl;
+    cout << "benchmarked up to " << maxThreads << " threads" << endl;
+    remove(dictFile.c_str());
 }
 
-// INPUT: a string m representing one of the hash code implementations
-// PRECONDITION: m must be one of {"poly", "simple", "cyclic", "custom"}
-// POSTCONDITION: the hash table will use the specified hash code function when hashing
-void HashMap::setHashCodeMethod(string m)
+// Spell-checks a whole document in parallel. The document is mapped, cut into chunks of about CHUNK bytes
+// at whitespace, and the chunks are checked on a work-stealing pool against H, which is only read. The
+// calling thread prints each chunk's misspelled words as soon as that chunk and all earlier ones are
+// done, so the output is in document order while later chunks are still being checked.
+// INPUT: dictionary H, name of the document, number of worker threads
+// OUTPUT: false if the document cannot be opened
+// POSTCONDITION: prints the misspelled words of the document like the check command does for one line:
+// words are separated by whitespace and compared in lower case. Each chunk is lowercased into a buffer of
+// its own in one pass and the words are looked up as views into it.
+bool checkFile(const HashMap& H, string fname, int threads)
 {
-    if (m == "poly")
+    const size_t CHUNK = 1 << 20;
+    MappedFile file;
+    if (!file.open(fname))
     {
-        this->HashCodeMethod = poly;
+        return false;
     }
-
-    if (m == "simple")
+    const char* text = file.data();
+    size_t len = file.size();
+    vector<size_t> bounds(1, 0);
+    while (bounds.back() < len)
     {
-        this->HashCodeMethod = simple;
+        size_t end = std::min(bounds.back() + CHUNK, len);
+        while (end < len && !isspace((unsigned char) text[end]))
+        {
+            end++;
+        }
+        bounds.push_back(end);
     }
+    int chunks = bounds.size() - 1;
 
-    if (m == "cyclic")
+    vector<string> output(chunks);
+    vector<char> done(chunks, 0);
+    std::mutex doneLock;
+    std::condition_variable doneSignal;
+    WorkStealingPool pool(threads);
+    pool.start(chunks, [&](int c)
     {
-        this->HashCodeMethod = cyclic;
-    }
+        string misspelled;
+        const char* chunk = text + bounds[c];
+        vector<char> lower(bounds[c + 1] - bounds[c]);
+        lowercase(lower.data(), chunk, lower.size());
+        Tokenizer words(lower.data(), lower.size());
+        size_t start, end;
+        while (words.next(start, end))
+        {
+            if (!H.contains(string_view(&lower[start], end - start)))
+            {
+                misspelled += "\t";
+                misspelled.append(&lower[start], end - start);
+            }
+        }
+        std::lock_guard<std::mutex> guard(doneLock);
+        output[c].swap(misspelled);
+        done[c] = 1;
+        doneSignal.notify_one();
+    });
 
-    if (m == "custom")
+    cout << "misspelled:";
+    for (int c = 0; c < chunks; c++)
     {
-        this->HashCodeMethod = custom;
+        std::unique_lock<std::mutex> guard(doneLock);
+        doneSignal.wait(guard, [&done, c]() { return done[c] != 0; });
+        string chunkOutput;
+        chunkOutput.swap(output[c]);
+        guard.unlock();
+        cout << chunkOutput;
     }
+    cout << endl;
+    pool.wait();
+    return true;
 }
 
-HashMap::~HashMap()
+// Checks text read from in and writes one line per misspelled word to out: its line and column (both
+// counted from 1, columns in bytes) and the word as written. There is no echo of the input. Input is read
+// and output written in blocks, so memory use does not depend on the input size; a word longer than a
+// block is checked as two words.
+// INPUT: the dictionary, the text stream and the output stream
+// OUTPUT: number of misspelled words
+size_t checkStream(HashMap& H, FILE* in, FILE* out)
 {
-    this->deleteTable();
+    const size_t BLOCK = 1 << 20;
+    vector<char> buffer(BLOCK), lower(BLOCK);
+    string output;
+    size_t misspelled = 0, lineNo = 1;
+    uint64_t offset = 0, lineStart = 0; // input offsets of buffer[0] and of the current line
+    size_t carry = 0; // bytes of a word cut by the end of the last block, moved to the front of buffer
+    for (bool eof = false; !eof; )
+    {
+        size_t got = fread(&buffer[carry], 1, BLOCK - carry, in);
+        eof = got == 0;
+        size_t len = carry + got;
+        carry = 0;
+        lowercase(&lower[0], &buffer[0], len);
+        Tokenizer words(&buffer[0], len);
+        size_t start, end, gap = 0;
+        while (words.next(start, end))
+        {
+            for (; gap < start; gap++) // only whitespace lies between words
+            {
+                if (buffer[gap] == '\n')
+                {
+                    lineNo++;
+                    lineStart = offset + gap + 1;
+                }
+            }
+            if (end == len && !eof && start > 0) // the word may go on in the next block
+            {
+                carry = len - start;
+                memmove(&buffer[0], &buffer[start], carry);
+                break;
+            }
+            if (!H.check(string_view(&lower[start], end - start)))
+            {
+                misspelled++;
+                output += to_string(lineNo);
+                output += ':';
+                output += to_string(offset + start - lineStart + 1);
+                output += '\t';
+                output.append(&buffer[start], end - start);
+                output += '\n';
+            }
+            gap = end;
+        }
+        for (; carry == 0 && gap < len; gap++)
+        {
+            if (buffer[gap] == '\n')
+            {
+                lineNo++;
+                lineStart = offset + gap + 1;
+            }
+        }
+        offset += len - carry;
+        if (output.length() >= BLOCK || eof)
+        {
+            fwrite(output.data(), 1, output.length(), out);
+            output.clear();
+        }
+    }
+    fflush(out);
+    return misspelled;
 }
 
-int main()
+// INPUT: (optional) name of the command file to run, input.txt by default; or --stream and a dictionary
+int main(int argc, char* argv[])
 {
-    string inputFilename = "input.txt";
+    if (argc > 2 && string(argv[1]) == "--stream")
+    {
+        // pipeline mode: check stdin against a word list or snapshot and write misspellings to stdout
+        HashMap H = HashMap();
+        if (!H.openSnapshot(argv[2]) && !H.load(string(argv[2])))
+        {
+            cerr << "Cannot open file " << argv[2] << endl;
+            return EXIT_FAILURE;
+        }
+        checkStream(H, stdin, stdout);
+        return EXIT_SUCCESS;
+    }
+    string inputFilename = argc > 1 ? argv[1] : "input.txt";
     string line;
     HashMap H = HashMap();
+    Fst F; // the dictionary of load, save, open, find and check after "backend fst"
+    Dawg D; // the dictionary of load, find, check and suggest after "backend dawg"
+    string backend = "hashmap";
 
     // open input file
     ifstream inputFile;
@@ -404,20 +5463,22 @@ int main()
         // echo input
         cout << line << endl;
 
-        // parse input using a stringstream
-        stringstream lineSS(line);
-        string token;
+        // split input on spaces; tokens are views into line, so they are never copied
         string command;
+        vector<string> args; // arguments of commands that take more than one
+        size_t end = 0;
 
-        while (getline(lineSS, token, ' '))
+        for (size_t tokenPos = 0; tokenPos < line.length(); tokenPos = end + 1)
         {
+            end = std::min(line.find(' ', tokenPos), line.length());
+            string_view token(&line[tokenPos], end - tokenPos);
             // trim whitespace
-            token.erase(token.find_last_not_of(" \n\r\t") + 1);
+            token = token.substr(0, token.find_last_not_of(" \n\r\t") + 1);
 
             // first token is the command
             if (command.empty())
             {
-                token = lowercase(token);
+                token = lowercase(&line[tokenPos], token.length());
                 command = token;
                 if (command == "check")
                 {
@@ -429,26 +5490,77 @@ int main()
             // subsequent tokens are associated with that command
             if (command == "resize")
             {
-                H.resizeTable(atoi(token.c_str()));
+                H.setMinSize(atoi(string(token).c_str()));
+            }
+            if (command == "max_load")
+            {
+                H.setMaxLoadFactor(atof(string(token).c_str()));
+            }
+            if (command == "min_load")
+            {
+                H.setMinLoadFactor(atof(string(token).c_str()));
+            }
+            if (command == "backend")
+            {
+                token = lowercase(&line[tokenPos], token.length());
+                if (token == "hashmap" || token == "fst" || token == "dawg")
+                {
+                    backend = token;
+                }
             }
             if (command == "load")
             {
-                ifstream wordsFile;
-                loadFile(token, wordsFile);
-                H.load(wordsFile);
-                wordsFile.close();
+                bool loaded = backend == "fst" ? F.load(string(token)) :
+                              backend == "dawg" ? D.load(string(token)) : H.load(string(token));
+                if (!loaded)
+                {
+                    cout << "Cannot open file " << token << endl;
+                }
+            }
+            if ((command == "save" || command == "open") && backend == "dawg")
+            {
+                cout << command << " needs backend hashmap or fst" << endl;
+                continue;
+            }
+            if (command == "save")
+            {
+                if (backend == "fst" ? !F.save(string(token)) : !H.saveSnapshot(string(token)))
+                {
+                    cout << "Cannot save snapshot " << token << endl;
+                }
+            }
+            if (command == "open")
+            {
+                if (backend == "fst" ? !F.open(string(token)) : !H.openSnapshot(string(token)))
+                {
+                    cout << "Cannot open snapshot " << token << endl;
+                }
+            }
+            if ((command == "put" || command == "erase") && backend != "hashmap")
+            {
+                cout << "Cannot change the " << backend << " dictionary" << endl;
+                continue;
             }
             if (command == "put")
             {
-                token = lowercase(token);
+                token = lowercase(&line[tokenPos], token.length());
                 H.put(token);
             }
             if (command == "find")
             {
-                token = lowercase(token);
-                int bucketIdx = H.find(token);
+                token = lowercase(&line[tokenPos], token.length());
+                int bucketIdx = backend == "fst" ? F.find(token) :
+                                backend == "dawg" ? (D.contains(token) ? 0 : -1) : H.find(token);
                 cout << token << ": ";
-                if (bucketIdx >= 0)
+                if (bucketIdx >= 0 && backend == "fst")
+                {
+                    cout << "found " << bucketIdx << " (payload " << F.payload(bucketIdx) << ")" << endl;
+                }
+                else if (bucketIdx >= 0 && backend == "dawg")
+                {
+                    cout << "found" << endl;
+                }
+                else if (bucketIdx >= 0)
                 {
                     cout << "found " << bucketIdx << endl;
                 }
@@ -459,22 +5571,64 @@ int main()
             }
             if (command == "erase")
             {
-                token = lowercase(token);
+                token = lowercase(&line[tokenPos], token.length());
                 H.erase(token);
             }
             if (command == "check")
             {
-                token = lowercase(token);
-                int bucketIdx = H.find(token);
-                if (bucketIdx < 0)
+                token = lowercase(&line[tokenPos], token.length());
+                bool known = backend == "fst" ? F.find(token) >= 0 :
+                             backend == "dawg" ? D.contains(token) : H.check(token);
+                if (!known)
                 {
                     cout << "\t" << token;
                 }
             }
+            if (command == "prefix")
+            {
+                token = lowercase(&line[tokenPos], token.length());
+                args.push_back(string(token));
+            }
             if (command == "hash_code")
             {
-                token = lowercase(token);
-                H.setHashCodeMethod(token);
+                token = lowercase(&line[tokenPos], token.length());
+                H.setHashCodeMethod(string(token));
+            }
+            if (command == "table")
+            {
+                token = lowercase(&line[tokenPos], token.length());
+                H.setTableMode(string(token));
+            }
+            if (command == "rehash_mode")
+            {
+                token = lowercase(&line[tokenPos], token.length());
+                H.setRehashMode(string(token));
+            }
+            if (command == "rehash_step")
+            {
+                H.setRehashStep(atoi(string(token).c_str()));
+            }
+            if (command == "bloom")
+            {
+                H.setBloomBits(atoi(string(token).c_str()));
+            }
+            if (command == "suggest_backend")
+            {
+                token = lowercase(&line[tokenPos], token.length());
+                H.setSuggestBackend(string(token));
+            }
+            if (command == "suggest_prefix")
+            {
+                H.setSuggestPrefix(atoi(string(token).c_str()));
+            }
+            if (command == "suggest")
+            {
+                token = lowercase(&line[tokenPos], token.length());
+                args.push_back(string(token));
+            }
+            if (command == "bench" || command == "bench_threads" || command == "check_file")
+            {
+                args.push_back(string(token));
             }
         }
 
@@ -483,21 +5637,101 @@ int main()
         {
             H.print();
         }
-        if (command == "stats")
+        if (command == "stats" && backend == "fst")
+        {
+            F.printStats();
+        }
+        if (command == "stats" && backend == "dawg")
+        {
+            D.printStats();
+        }
+        if (command == "stats" && backend == "hashmap")
         {
             H.printStats();
         }
+        if (command == "prefix" && !args.empty() && backend != "fst")
+        {
+            cout << "prefix needs backend fst" << endl;
+        }
+        if (command == "prefix" && !args.empty() && backend == "fst")
+        {
+            vector<std::pair<string, uint32_t> > words;
+            F.listPrefix(args[0], args.size() > 1 ? atoi(args[1].c_str()) : 10, words);
+            cout << args[0] << ":";
+            for (size_t i = 0; i < words.size(); i++)
+            {
+                cout << "\t" << words[i].first << " (" << words[i].second << ")";
+            }
+            cout << endl;
+        }
+        if (command == "analyze")
+        {
+            H.analyze();
+        }
+        if (command == "freeze" && !H.freeze())
+        {
+            cout << "Cannot freeze dictionary" << endl;
+        }
         if (command == "rehash")
         {
-            H.resizeTable(H.size());
+            H.rehash();
         }
         if (command == "check")
         {
             cout << endl;
         }
+        if (command == "suggest" && !args.empty())
+        {
+            vector<Suggestion> suggestions;
+            int maxDist = args.size() > 1 ? atoi(args[1].c_str()) : -1;
+            KeyArena words; // the words suggested by the dawg backend
+            if (backend == "dawg")
+            {
+                // the same distances as HashMap::suggest
+                if (maxDist < 0)
+                {
+                    maxDist = HashMap::SUGGEST_DISTANCE;
+                }
+                if (maxDist > HashMap::SUGGEST_MAX_DISTANCE)
+                {
+                    maxDist = HashMap::SUGGEST_MAX_DISTANCE;
+                }
+                D.lookup(args[0], maxDist, suggestions, words);
+            }
+            else
+            {
+                H.suggest(args[0], maxDist, suggestions);
+            }
+            cout << args[0] << ":";
+            for (size_t i = 0; i < suggestions.size() && i < 10; i++)
+            {
+                cout << "\t" << suggestions[i].word << " (" << suggestions[i].distance << ")";
+            }
+            cout << (suggestions.empty() ? " no suggestions" : "") << endl;
+        }
+        if (command == "bench" && !args.empty())
+        {
+            runBenchmark(args[0], args.size() > 1 ? atoi(args[1].c_str()) : 1000000);
+        }
+        if (command == "check_file" && !args.empty())
+        {
+            int cores = std::max(int(std::thread::hardware_concurrency()), 1);
+            int threads = args.size() > 1 ? atoi(args[1].c_str()) : cores;
+            if (!checkFile(H, args[0], std::max(threads, 1)))
+            {
+                cout << "Cannot open file " << args[0] << endl;
+            }
+        }
+        if (command == "bench_threads" && !args.empty())
+        {
+            int cores = std::max(int(std::thread::hardware_concurrency()), 1);
+            runThreadBenchmark(args[0], args.size() > 1 ? atoi(args[1].c_str()) : cores, 1000000);
+        }
     }
 
     inputFile.close();
+#ifdef _WIN32
     system("pause"); // Added by MP
+#endif
     return EXIT_SUCCESS;
 }
\ No newline at end of file